@@ -20,6 +20,16 @@
 #include "imoddata.h"
 #include "iplugins.h"
 
+// Plugin utilities
+#include "plugineventbatches.h"
+#include "plugineventfilters.h"
+#include "plugineventstats.h"
+#include "plugineventtrace.h"
+#include "pluginjobs.h"
+#include "pluginpacketstats.h"
+#include "plugintimers.h"
+#include "pluginworkqueue.h"
+
 //================================================================================================//
 // Hooking up Classics Patch API
 //
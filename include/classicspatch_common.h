@@ -101,6 +101,19 @@ inline void CopyZeroTerminatedString(char *pchDst, const char *pchSrc, size_t cc
   pchDst[cchDstLength] = '\0'; // Set null-terminator as the last character
 };
 
+// Calculate 32-bit FNV-1a hash of a null-terminated string
+// Used for building lookup tables for named entries (e.g. extension properties)
+inline ULONG MakeNameHash(const char *str)
+{
+  ULONG ulHash = 2166136261UL;
+
+  for (; *str != '\0'; str++) {
+    ulHash = ((ulHash ^ (UBYTE)*str) * 16777619UL) & 0xFFFFFFFFUL;
+  }
+
+  return ulHash;
+};
+
 #define CLASSICSPATCH_STRINGIFY_INTERNAL(x) #x
 #define CLASSICSPATCH_STRINGIFY(x) CLASSICSPATCH_STRINGIFY_INTERNAL(x)
 
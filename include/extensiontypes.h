@@ -17,6 +17,8 @@
 // The comments before the structures describe which signal in which extension they belong to in
 // this format: "extension_identifier" - "signal_name".
 // All signals expect 'void *' arguments to be pointers to structures, e.g. 'UnknownProperty_t *'.
+// Signals that are called often should be resolved once via ExtensionSignalRef_t with the matching
+// structure as its template argument, e.g. 'ExtensionSignalRef_t<ExtArgWorldConverter_t>'.
 //
 // This is not strictly a part of the API but rather a way to eliminate potential mismatch of data
 // between the signals and the code that calls them.
@@ -36,6 +36,7 @@
 // using their type for custom processing, if necessary, albeit not recommended.
 //================================================================================================//
 
+class CNetworkMessage;
 class IClassicsExtPacket;
 
 // Report packet actions to the server
@@ -119,6 +120,177 @@ public:
   virtual void Process(void) {};
 };
 
+// Function for processing received extension packets of specific types
+// Same as INetworkEvents::OnServerPacket and INetworkEvents::OnClientPacket
+typedef BOOL (PATCH_CALLTYPE *FExtPacketHandler)(class CNetworkMessage &nmMessage, const ULONG ulType);
+
+// Table for routing received extension packets to handlers of specific packet types
+//
+// Instead of checking each packet type one by one, handlers are registered for specific types or ranges
+// of types and then looked up directly in a table by the type of each received packet. Packets of unknown
+// types are passed into an optional fallback handler.
+// Example usage:
+//    static ExtPacketRouter_t _routerServer;
+//
+//    BOOL PATCH_CALLTYPE INetworkEvents_OnServerPacket(CNetworkMessage &nmMessage, const ULONG ulType) {
+//      return _routerServer.Dispatch(nmMessage, ulType);
+//    };
+//
+//    CLASSICSPATCH_PLUGIN_STARTUP(HIniConfig props, PluginEvents_t &events) {
+//      _routerServer.Register(k_EPacketType_MyCustomPacketType, &HandleMyCustomPacket);
+//      _routerServer.RegisterRange(k_EPacketType_MyFirstStatPacket, k_EPacketType_MyLastStatPacket, &HandleStatPackets);
+//      events.m_network->OnServerPacket = &INetworkEvents_OnServerPacket;
+//    };
+struct ExtPacketRouter_t
+{
+  // Ranges of types that are too big or too far from other types to be put in the table
+  struct Range_t {
+    ULONG m_ulFirst;
+    ULONG m_ulLast;
+    FExtPacketHandler m_pHandler;
+  };
+
+  // Maximum amount of types that the table can span
+  enum { k_ctMaxTableRange = 4096 };
+
+  // Handlers of consecutive types starting from the first one
+  ULONG m_ulFirstType;
+  ULONG m_ctTypes;
+  FExtPacketHandler *m_apHandlers;
+
+  Range_t *m_aRanges;
+  int m_ctRanges;
+
+  // Handler for packets of unregistered types (may be NULL)
+  FExtPacketHandler m_pFallback;
+
+  ExtPacketRouter_t() : m_ulFirstType(0), m_ctTypes(0), m_apHandlers(NULL),
+    m_aRanges(NULL), m_ctRanges(0), m_pFallback(NULL) {};
+
+  ~ExtPacketRouter_t() {
+    Clear();
+  };
+
+  // Unregister all handlers
+  void Clear(void)
+  {
+    delete[] m_apHandlers;
+    delete[] m_aRanges;
+    m_ulFirstType = 0;
+    m_ctTypes = 0;
+    m_apHandlers = NULL;
+    m_aRanges = NULL;
+    m_ctRanges = 0;
+    m_pFallback = NULL;
+  };
+
+  // Register handler for a specific packet type, replacing the previous one
+  inline void Register(ULONG ulType, FExtPacketHandler pHandler) {
+    RegisterRange(ulType, ulType, pHandler);
+  };
+
+  // Register handler for a range of packet types (both inclusive)
+  void RegisterRange(ULONG ulFirst, ULONG ulLast, FExtPacketHandler pHandler)
+  {
+    if (ulLast < ulFirst) return;
+
+    // Put big ranges into a separate list
+    if (ulLast - ulFirst >= k_ctMaxTableRange) {
+      AddRange(ulFirst, ulLast, pHandler);
+      return;
+    }
+
+    // Expand the table to fit new types
+    const ULONG ulNewFirst = (m_ctTypes == 0 || ulFirst < m_ulFirstType) ? ulFirst : m_ulFirstType;
+    const ULONG ulOldLast = m_ulFirstType + m_ctTypes - 1;
+    const ULONG ulNewLast = (m_ctTypes == 0 || ulLast > ulOldLast) ? ulLast : ulOldLast;
+
+    // Put types that are too far from the table into the list as well
+    if (ulNewLast - ulNewFirst >= k_ctMaxTableRange) {
+      AddRange(ulFirst, ulLast, pHandler);
+      return;
+    }
+
+    const ULONG ctNewTypes = ulNewLast - ulNewFirst + 1;
+
+    if (ctNewTypes != m_ctTypes) {
+      FExtPacketHandler *apNewHandlers = new FExtPacketHandler[ctNewTypes];
+      memset(apNewHandlers, 0, sizeof(FExtPacketHandler) * ctNewTypes);
+
+      if (m_ctTypes != 0) {
+        memcpy(apNewHandlers + (m_ulFirstType - ulNewFirst), m_apHandlers, sizeof(FExtPacketHandler) * m_ctTypes);
+      }
+
+      delete[] m_apHandlers;
+      m_apHandlers = apNewHandlers;
+      m_ulFirstType = ulNewFirst;
+      m_ctTypes = ctNewTypes;
+    }
+
+    for (ULONG ulType = ulFirst; ulType <= ulLast; ulType++) {
+      m_apHandlers[ulType - m_ulFirstType] = pHandler;
+    }
+  };
+
+  // Set handler for packets of unregistered types
+  inline void SetFallback(FExtPacketHandler pHandler) {
+    m_pFallback = pHandler;
+  };
+
+  // Pass a received packet into the handler of its type
+  // Returns false if the packet hasn't been handled
+  BOOL Dispatch(class CNetworkMessage &nmMessage, const ULONG ulType) const
+  {
+    // Unsigned subtraction also discards types below the first one
+    const ULONG iTableType = ulType - m_ulFirstType;
+
+    if (iTableType < m_ctTypes && m_apHandlers[iTableType] != NULL) {
+      return m_apHandlers[iTableType](nmMessage, ulType);
+    }
+
+    // Later ranges take priority
+    for (int iRange = m_ctRanges - 1; iRange >= 0; iRange--) {
+      const Range_t &range = m_aRanges[iRange];
+
+      if (ulType >= range.m_ulFirst && ulType <= range.m_ulLast) {
+        return range.m_pHandler(nmMessage, ulType);
+      }
+    }
+
+    if (m_pFallback != NULL) return m_pFallback(nmMessage, ulType);
+    return FALSE;
+  };
+
+private:
+  // Add a range into the list, replacing the handler of the same exact range
+  void AddRange(ULONG ulFirst, ULONG ulLast, FExtPacketHandler pHandler)
+  {
+    for (int iRange = 0; iRange < m_ctRanges; iRange++) {
+      Range_t &range = m_aRanges[iRange];
+
+      if (range.m_ulFirst == ulFirst && range.m_ulLast == ulLast) {
+        range.m_pHandler = pHandler;
+        return;
+      }
+    }
+
+    Range_t *aNewRanges = new Range_t[m_ctRanges + 1];
+
+    if (m_ctRanges != 0) memcpy(aNewRanges, m_aRanges, sizeof(Range_t) * m_ctRanges);
+    delete[] m_aRanges;
+
+    m_aRanges = aNewRanges;
+    m_aRanges[m_ctRanges].m_ulFirst = ulFirst;
+    m_aRanges[m_ctRanges].m_ulLast = ulLast;
+    m_aRanges[m_ctRanges].m_pHandler = pHandler;
+    m_ctRanges++;
+  };
+
+  // Routers own their tables and cannot be copied
+  ExtPacketRouter_t(const ExtPacketRouter_t &);
+  ExtPacketRouter_t &operator=(const ExtPacketRouter_t &);
+};
+
 //================================================================================================//
 // Built-in extension packets
 //
@@ -180,6 +352,807 @@ PATCH_API IClassicsBuiltInExtPacket *PATCH_CALLTYPE ClassicsPackets_Create(IClas
 // Destroy previously created built-in extension packet
 PATCH_API void PATCH_CALLTYPE ClassicsPackets_Destroy(IClassicsBuiltInExtPacket *pExtPacket);
 
+//================================================================================================//
+// Built-in extension packet pools
+//
+// Creating and destroying built-in packets allocates and frees memory each time. Plugins that send
+// hundreds of packets per tick can instead reuse the same instances by acquiring them from a pool
+// and releasing them back into it after sending. New instances are only created when the pool runs
+// out of released ones.
+//
+// Reused packets keep property values that have been set before releasing them, so all properties
+// that matter should be set anew after acquiring a packet.
+//
+// Pooled packets are destroyed via ClassicsPackets_Destroy(), so the pool needs to be cleared upon
+// plugin shutdown while Classics Patch is still running.
+//
+// Example usage:
+//    {
+//      ExtPacketHandle_t pck(IClassicsExtPacket::k_EPacketType_EntityHealth);
+//      pck->SetIntProp("iEntity", pen->en_ulID);
+//      pck->SetFloatProp("fHealth", 100.0);
+//      pck->SendToClients();
+//    } // Released back into ExtPacketPool()
+//
+//    CLASSICSPATCH_PLUGIN_SHUTDOWN(HIniConfig props) {
+//      ExtPacketPool().Clear();
+//    };
+//================================================================================================//
+
+// Free lists of released built-in packets
+class ExtPacketPool_t
+{
+public:
+  // Maximum amount of released packets kept per type, after which they're destroyed
+  enum { k_ctMaxPerType = 256 };
+
+  // Released packets of one type
+  struct FreeList_t {
+    IClassicsBuiltInExtPacket **m_apPackets;
+    int m_ctPackets;
+    int m_ctAllocated;
+  };
+
+  FreeList_t m_aFree[IClassicsExtPacket::k_EPacketType_Max];
+
+public:
+  ExtPacketPool_t() {
+    memset(m_aFree, 0, sizeof(m_aFree));
+  };
+
+  ~ExtPacketPool_t() {
+    Clear();
+  };
+
+  // Get a packet of some type, creating a new one only if there are no released ones
+  // Returns NULL if packets of this type cannot be created
+  IClassicsBuiltInExtPacket *Acquire(IClassicsExtPacket::EPacketType ePacket)
+  {
+    if ((ULONG)ePacket < (ULONG)IClassicsExtPacket::k_EPacketType_Max) {
+      FreeList_t &list = m_aFree[ePacket];
+      if (list.m_ctPackets != 0) return list.m_apPackets[--list.m_ctPackets];
+    }
+
+    return ClassicsPackets_Create(ePacket);
+  };
+
+  // Return a packet into the pool after it's been sent or processed
+  void Release(IClassicsBuiltInExtPacket *pPacket)
+  {
+    if (pPacket == NULL) return;
+
+    const ULONG ulType = pPacket->GetType();
+
+    if (ulType >= (ULONG)IClassicsExtPacket::k_EPacketType_Max || m_aFree[ulType].m_ctPackets >= k_ctMaxPerType) {
+      ClassicsPackets_Destroy(pPacket);
+      return;
+    }
+
+    FreeList_t &list = m_aFree[ulType];
+
+    if (list.m_ctPackets == list.m_ctAllocated) {
+      const int ctNewAllocated = (list.m_ctAllocated == 0) ? 16 : list.m_ctAllocated * 2;
+      IClassicsBuiltInExtPacket **apNewPackets = new IClassicsBuiltInExtPacket *[ctNewAllocated];
+
+      if (list.m_ctPackets != 0) memcpy(apNewPackets, list.m_apPackets, sizeof(IClassicsBuiltInExtPacket *) * list.m_ctPackets);
+      delete[] list.m_apPackets;
+
+      list.m_apPackets = apNewPackets;
+      list.m_ctAllocated = ctNewAllocated;
+    }
+
+    list.m_apPackets[list.m_ctPackets++] = pPacket;
+  };
+
+  // Destroy all released packets
+  void Clear(void)
+  {
+    for (int iType = 0; iType < IClassicsExtPacket::k_EPacketType_Max; iType++) {
+      FreeList_t &list = m_aFree[iType];
+
+      for (int i = 0; i < list.m_ctPackets; i++) {
+        ClassicsPackets_Destroy(list.m_apPackets[i]);
+      }
+
+      delete[] list.m_apPackets;
+      list.m_apPackets = NULL;
+      list.m_ctPackets = 0;
+      list.m_ctAllocated = 0;
+    }
+  };
+
+private:
+  // Pools own their packets and cannot be copied
+  ExtPacketPool_t(const ExtPacketPool_t &);
+  ExtPacketPool_t &operator=(const ExtPacketPool_t &);
+};
+
+// Built-in packet pool of the current module
+inline ExtPacketPool_t &ExtPacketPool(void) {
+  static ExtPacketPool_t _pool;
+  return _pool;
+};
+
+// Built-in packet that's acquired from a pool and automatically released back into it
+class ExtPacketHandle_t
+{
+public:
+  ExtPacketPool_t *m_pPool;
+  IClassicsBuiltInExtPacket *m_pPacket; // May be NULL if the packet couldn't be created
+
+public:
+  ExtPacketHandle_t(IClassicsExtPacket::EPacketType ePacket, ExtPacketPool_t &pool = ExtPacketPool()) :
+    m_pPool(&pool), m_pPacket(pool.Acquire(ePacket)) {};
+
+  ~ExtPacketHandle_t() {
+    m_pPool->Release(m_pPacket);
+  };
+
+  inline bool IsValid(void) const {
+    return (m_pPacket != NULL);
+  };
+
+  inline IClassicsBuiltInExtPacket *Get(void) const {
+    return m_pPacket;
+  };
+
+  inline IClassicsBuiltInExtPacket *operator->(void) const {
+    return m_pPacket;
+  };
+
+  // Take the packet from the handle, so that it's not released automatically
+  inline IClassicsBuiltInExtPacket *Detach(void)
+  {
+    IClassicsBuiltInExtPacket *pPacket = m_pPacket;
+    m_pPacket = NULL;
+    return pPacket;
+  };
+
+private:
+  // Handles own their packets and cannot be copied
+  ExtPacketHandle_t(const ExtPacketHandle_t &);
+  ExtPacketHandle_t &operator=(const ExtPacketHandle_t &);
+};
+
+//================================================================================================//
+// Extension packet bundles
+//
+// Each sent extension packet is a separate network message with its own headers. Plugins that send
+// many small packets during a single tick can instead queue them in a bundle, which is then sent
+// as a single custom extension packet that contains type and length of each queued packet followed
+// by its data.
+//
+// Bundles are received as custom extension packets of a type chosen by the plugin, so receivers
+// also need to have the plugin. Bundled built-in packets are read and processed in the same way as
+// the patch does it, while custom packets are passed into handlers of an ExtPacketRouter_t. Built-in
+// packets are only processed if they are meant to be received on that side, e.g. the server ignores
+// server-to-client packets in bundles from clients.
+//
+// Bundles access internal fields of network messages, so Serious Engine headers are required. Packets
+// are written right into the bundle message and measured afterwards, and the ones that don't fit are
+// rolled back out of it.
+//
+// Example usage:
+//    static ExtPacketBundle_t<> _bundle(k_EPacketType_MyBundle);
+//    static ExtPacketRouter_t _routerClient;
+//
+//    // Queue packets at any point during the tick
+//    IClassicsBuiltInExtPacket *pck = ExtPacketPool().Acquire(IClassicsExtPacket::k_EPacketType_EntityEvent);
+//    ...
+//    _bundle.AddBuiltIn(pck); // Released into ExtPacketPool() after sending
+//
+//    void PATCH_CALLTYPE ITimerEvents_OnTick(void) {
+//      _bundle.FlushToClients();
+//    };
+//
+//    BOOL PATCH_CALLTYPE INetworkEvents_OnClientPacket(CNetworkMessage &nmMessage, const ULONG ulType) {
+//      if (ulType != k_EPacketType_MyBundle) return FALSE;
+//      ExtPacketBundle_Dispatch(nmMessage, false, &_routerClient);
+//      return TRUE;
+//    };
+//================================================================================================//
+
+// Size of the bundle data after which remaining packets are left for the next bundle
+const int k_ctExtPacketBundleSoftLimit = 1024;
+
+// Maximum size of a network message
+// Packets that would make the bundle exceed it are left for the next bundle, or discarded if they don't fit on their own
+const int k_ctExtPacketMaxMessageSize = 2048;
+
+// Write type and length of a packet followed by its data into a message that contains other packets
+// Returns false and leaves the message unchanged if the packet cannot be written
+template<class MessageType> inline
+bool ExtPacket_WriteEntry(MessageType &nm, IClassicsExtPacket *pPacket)
+{
+  UBYTE *pubHeader = nm.nm_pubPointer;
+
+  const ULONG ulType = pPacket->GetType();
+  UWORD uwLength = 0;
+  nm.Write(&ulType, sizeof(ulType));
+  nm.Write(&uwLength, sizeof(uwLength));
+
+  UBYTE *pubData = nm.nm_pubPointer;
+
+  if (!pPacket->Write((class CNetworkMessage &)nm)) {
+    nm.nm_slSize -= SLONG(nm.nm_pubPointer - pubHeader);
+    nm.nm_pubPointer = pubHeader;
+    return false;
+  }
+
+  // Write actual length before the data
+  uwLength = UWORD(nm.nm_pubPointer - pubData);
+  memcpy(pubData - sizeof(uwLength), &uwLength, sizeof(uwLength));
+  return true;
+};
+
+// Check whether a built-in packet of some type may be received on a specific side
+// The server only accepts client-to-server packets and clients only accept server-to-client packets
+inline bool ExtPacket_IsBuiltInAccepted(ULONG ulType, bool bOnServer)
+{
+  if (bOnServer) {
+    return (ulType >= IClassicsExtPacket::k_EPacketType_FirstC2S && ulType <= IClassicsExtPacket::k_EPacketType_LastC2S);
+  }
+
+  return (ulType <= IClassicsExtPacket::k_EPacketType_LastS2C);
+};
+
+// Read and process data of one packet from a message that contains other packets
+// Built-in packets are processed in the same way as the patch does it and custom ones are passed into the router
+// Built-in packets that aren't meant to be received on this side are ignored
+// Returns whether the packet has been handled
+template<class MessageType> inline
+bool ExtPacket_DispatchEntry(MessageType &nm, ULONG ulType, bool bOnServer, const ExtPacketRouter_t *pRouter)
+{
+  if (ulType < IClassicsExtPacket::k_EPacketType_Max) {
+    if (!ExtPacket_IsBuiltInAccepted(ulType, bOnServer)) return false;
+
+    ExtPacketHandle_t pck((IClassicsExtPacket::EPacketType)ulType);
+    if (!pck.IsValid()) return false;
+
+    pck->Read(nm);
+    pck->Process();
+    return true;
+  }
+
+  return (pRouter != NULL && pRouter->Dispatch(nm, ulType));
+};
+
+// Collection of extension packets that are sent together
+template<class MessageType = CNetworkMessage>
+class ExtPacketBundle_t : public IClassicsExtPacket
+{
+public:
+  struct Entry_t {
+    IClassicsExtPacket *m_pPacket;
+    bool m_bBuiltIn; // Release into ExtPacketPool() after sending
+  };
+
+  // Custom packet type of the bundle itself
+  ULONG m_ulType;
+
+  Entry_t *m_aEntries;
+  int m_ctEntries;
+  int m_ctAllocated;
+
+  // Range of packets for the bundle that's currently being sent
+  int m_iFirst;
+  int m_iWritten;
+
+public:
+  ExtPacketBundle_t(ULONG ulType) : m_ulType(ulType), m_aEntries(NULL), m_ctEntries(0), m_ctAllocated(0),
+    m_iFirst(0), m_iWritten(0) {};
+
+  ~ExtPacketBundle_t() {
+    Clear();
+    delete[] m_aEntries;
+  };
+
+  virtual EPacketType GetType(void) const { return (EPacketType)m_ulType; };
+  virtual const char *GetName(void) const { return "ExtPacketBundle_t"; };
+
+  // Check whether there are any queued packets
+  inline bool IsEmpty(void) const {
+    return (m_ctEntries == 0);
+  };
+
+  // Queue a custom packet that's owned by the caller and should exist until the bundle is sent
+  inline void Add(IClassicsExtPacket *pPacket) {
+    AddEntry(pPacket, false);
+  };
+
+  // Queue a built-in packet that's released into ExtPacketPool() after the bundle is sent
+  inline void AddBuiltIn(IClassicsBuiltInExtPacket *pPacket) {
+    AddEntry(pPacket, true);
+  };
+
+  // Discard all queued packets without sending them
+  void Clear(void)
+  {
+    for (int i = 0; i < m_ctEntries; i++) {
+      if (m_aEntries[i].m_bBuiltIn) ExtPacketPool().Release((IClassicsBuiltInExtPacket *)m_aEntries[i].m_pPacket);
+    }
+
+    m_ctEntries = 0;
+    m_iFirst = 0;
+    m_iWritten = 0;
+  };
+
+  // Send all queued packets from server to all clients in as few bundles as possible
+  inline void FlushToClients(void) {
+    Flush(false);
+  };
+
+  // Send all queued packets from a client to the server in as few bundles as possible
+  inline void FlushToServer(void) {
+    Flush(true);
+  };
+
+  // Write as many queued packets as possible, starting from the first unsent one
+  virtual bool Write(class CNetworkMessage &nmMessage)
+  {
+    MessageType &nm = (MessageType &)nmMessage;
+
+    UBYTE *pubCount = nm.nm_pubPointer;
+    UWORD ctWritten = 0;
+    nm.Write(&ctWritten, sizeof(ctWritten));
+
+    const SLONG slStart = nm.nm_slSize;
+    int iEntry = m_iFirst;
+
+    for (; iEntry < m_ctEntries; iEntry++) {
+      if (ctWritten != 0 && nm.nm_slSize - slStart >= k_ctExtPacketBundleSoftLimit) break;
+
+      // Each packet is written right into the message and then measured to check whether it fits
+      UBYTE *pubEntry = nm.nm_pubPointer;
+      const SLONG slEntryStart = nm.nm_slSize;
+
+      // Discard packets that cannot be written
+      if (!ExtPacket_WriteEntry(nm, m_aEntries[iEntry].m_pPacket)) continue;
+
+      if (nm.nm_slSize > k_ctExtPacketMaxMessageSize) {
+        nm.nm_pubPointer = pubEntry;
+        nm.nm_slSize = slEntryStart;
+
+        if (ctWritten != 0) break;
+        continue;
+      }
+
+      ctWritten++;
+    }
+
+    memcpy(pubCount, &ctWritten, sizeof(ctWritten));
+    m_iWritten = iEntry;
+
+    return (ctWritten != 0);
+  };
+
+private:
+  void AddEntry(IClassicsExtPacket *pPacket, bool bBuiltIn)
+  {
+    if (m_ctEntries == m_ctAllocated) {
+      const int ctNewAllocated = (m_ctAllocated == 0) ? 32 : m_ctAllocated * 2;
+      Entry_t *aNewEntries = new Entry_t[ctNewAllocated];
+
+      if (m_ctEntries != 0) memcpy(aNewEntries, m_aEntries, sizeof(Entry_t) * m_ctEntries);
+      delete[] m_aEntries;
+
+      m_aEntries = aNewEntries;
+      m_ctAllocated = ctNewAllocated;
+    }
+
+    m_aEntries[m_ctEntries].m_pPacket = pPacket;
+    m_aEntries[m_ctEntries].m_bBuiltIn = bBuiltIn;
+    m_ctEntries++;
+  };
+
+  void Flush(bool bToServer)
+  {
+    m_iFirst = 0;
+
+    while (m_iFirst < m_ctEntries) {
+      // Network messages may be written more than once per send, so the range only moves after it
+      m_iWritten = m_ctEntries;
+
+      if (bToServer) {
+        SendToServer();
+      } else {
+        SendToClients();
+      }
+
+      m_iFirst = m_iWritten;
+    }
+
+    Clear();
+  };
+
+  // Bundles own their queues and cannot be copied
+  ExtPacketBundle_t(const ExtPacketBundle_t &);
+  ExtPacketBundle_t &operator=(const ExtPacketBundle_t &);
+};
+
+// Read and process every packet from a bundle that's been received on the server or on a client
+// Custom packets are passed into the router, if there's any
+// Returns amount of handled packets
+template<class MessageType> inline
+int ExtPacketBundle_Dispatch(MessageType &nm, bool bOnServer, const ExtPacketRouter_t *pRouter)
+{
+  UWORD ctPackets = 0;
+  nm.Read(&ctPackets, sizeof(ctPackets));
+
+  int ctHandled = 0;
+
+  for (int iPacket = 0; iPacket < ctPackets; iPacket++) {
+    ULONG ulType;
+    UWORD uwLength;
+    nm.Read(&ulType, sizeof(ulType));
+    nm.Read(&uwLength, sizeof(uwLength));
+
+    UBYTE *pubData = nm.nm_pubPointer;
+
+    // Malformed bundle
+    if (pubData + uwLength > nm.nm_pubMessage + nm.nm_slSize) break;
+
+    if (ExtPacket_DispatchEntry(nm, ulType, bOnServer, pRouter)) ctHandled++;
+
+    // Skip to the next packet regardless of how much has been read
+    nm.nm_pubPointer = pubData + uwLength;
+  }
+
+  return ctHandled;
+};
+
+//================================================================================================//
+// Targeted extension packets
+//
+// Extension packets from the server are always processed by all clients, even if they only matter
+// to specific players (e.g. HUD messages or effects for one player).
+//
+// Targeted packets wrap another packet together with a mask of player indices it's meant for, and
+// clients without any of the targeted players locally discard it without reading or processing its data.
+//
+// IMPORTANT: Classics Patch cannot send extension packets to specific clients, so targeted packets with
+// any recipients are still sent to every client. They don't save any bandwidth and are 10 bytes larger
+// than the wrapped packet (mask of players and entry header). Only packets without any recipients
+// aren't sent at all. Masks consist of player indices instead of client indices, because that's what
+// each client can check on its own side.
+//
+// Targeted packets are received as custom extension packets of a type chosen by the plugin, so
+// receivers also need to have the plugin.
+//
+// Targeted packets access internal fields of network messages, so Serious Engine headers are required.
+//
+// Example usage:
+//    static ExtPacketTargeted_t<> _pckTargeted(k_EPacketType_MyTargeted);
+//
+//    // Only let one player process a HUD message
+//    _pckTargeted.SendToPlayer(iPlayer, pck);
+//
+//    BOOL PATCH_CALLTYPE INetworkEvents_OnClientPacket(CNetworkMessage &nmMessage, const ULONG ulType) {
+//      if (ulType != k_EPacketType_MyTargeted) return FALSE;
+//      ExtPacketTargeted_Dispatch(nmMessage, ulLocalPlayers, &_routerClient);
+//      return TRUE;
+//    };
+//================================================================================================//
+
+// Maximum amount of players that can be targeted
+const int k_ctExtPacketMaxTargets = 32;
+
+// Mask of all players
+const ULONG k_ulExtPacketAllTargets = 0xFFFFFFFF;
+
+// Check whether a player index is among packet recipients
+inline bool ExtPacket_IsTarget(ULONG ulPlayers, int iPlayer) {
+  return (iPlayer >= 0 && iPlayer < k_ctExtPacketMaxTargets && (ulPlayers & (1UL << iPlayer)) != 0);
+};
+
+// Extension packet that's meant only for specific players
+template<class MessageType = CNetworkMessage>
+class ExtPacketTargeted_t : public IClassicsExtPacket
+{
+public:
+  // Custom packet type of the wrapper itself
+  ULONG m_ulType;
+
+  // Packet that's currently being sent and its recipients
+  IClassicsExtPacket *m_pPacket;
+  ULONG m_ulPlayers;
+
+public:
+  ExtPacketTargeted_t(ULONG ulType) : m_ulType(ulType), m_pPacket(NULL), m_ulPlayers(0) {};
+
+  virtual EPacketType GetType(void) const { return (EPacketType)m_ulType; };
+  virtual const char *GetName(void) const { return "ExtPacketTargeted_t"; };
+
+  // Send packet from server to all clients to be processed only by clients of specific players
+  // Returns false if there were no recipients and nothing has been sent
+  bool SendToPlayers(ULONG ulPlayers, IClassicsExtPacket *pPacket)
+  {
+    if (ulPlayers == 0) return false;
+
+    m_pPacket = pPacket;
+    m_ulPlayers = ulPlayers;
+    SendToClients();
+    m_pPacket = NULL;
+
+    return true;
+  };
+
+  // Send packet from server to all clients to be processed only by the client of one player
+  inline bool SendToPlayer(int iPlayer, IClassicsExtPacket *pPacket)
+  {
+    if (iPlayer < 0 || iPlayer >= k_ctExtPacketMaxTargets) return false;
+    return SendToPlayers(1UL << iPlayer, pPacket);
+  };
+
+  // Write recipients followed by the packet
+  virtual bool Write(class CNetworkMessage &nmMessage)
+  {
+    if (m_pPacket == NULL) return false;
+
+    MessageType &nm = (MessageType &)nmMessage;
+    nm.Write(&m_ulPlayers, sizeof(m_ulPlayers));
+
+    return ExtPacket_WriteEntry(nm, m_pPacket);
+  };
+
+private:
+  // Wrappers hold addresses of packets that are being sent and cannot be copied
+  ExtPacketTargeted_t(const ExtPacketTargeted_t &);
+  ExtPacketTargeted_t &operator=(const ExtPacketTargeted_t &);
+};
+
+// Read and process a targeted packet that's been received on a client if it's meant for any of the local players
+// Targeted packets are only sent from the server, so only server-to-client built-in packets are processed
+// Custom packets are passed into the router, if there's any
+// Returns whether the packet has been handled
+template<class MessageType> inline
+bool ExtPacketTargeted_Dispatch(MessageType &nm, ULONG ulLocalPlayers, const ExtPacketRouter_t *pRouter)
+{
+  ULONG ulPlayers;
+  ULONG ulType;
+  UWORD uwLength;
+  nm.Read(&ulPlayers, sizeof(ulPlayers));
+  nm.Read(&ulType, sizeof(ulType));
+  nm.Read(&uwLength, sizeof(uwLength));
+
+  UBYTE *pubData = nm.nm_pubPointer;
+
+  // Malformed packet
+  if (pubData + uwLength > nm.nm_pubMessage + nm.nm_slSize) return false;
+
+  bool bHandled = false;
+
+  if (ulPlayers & ulLocalPlayers) {
+    bHandled = ExtPacket_DispatchEntry(nm, ulType, false, pRouter);
+  }
+
+  nm.nm_pubPointer = pubData + uwLength;
+  return bHandled;
+};
+
+//================================================================================================//
+// Entity state filters
+//
+// Built-in packets like k_EPacketType_EntityPosition, k_EPacketType_EntityMove,
+// k_EPacketType_EntityRotate and k_EPacketType_EntityProp always send absolute values, even if
+// they're exactly the same as the ones that have been sent before.
+//
+// Filters remember the last sent state of each entity field, quantized to a specific precision, and
+// tell whether the quantized state has changed since then. Scripts that update many entities every
+// tick can then skip sending packets for entities that aren't actually changing. A state is only
+// remembered once it's committed after sending the packet, so packets that fail to be created or sent
+// are attempted again with the next check.
+//
+// This is a sender-side deduplication filter and not delta compression: packets still carry full
+// absolute values, and there's one shared state per field instead of one per client, because built-in
+// packets are sent to all clients at once. The filter needs to be reset whenever new clients connect,
+// in order to send full states to them.
+//
+// Example usage:
+//    static ExtPacketStateFilter_t _filter(0.01); // Centimeter precision
+//
+//    // Every tick
+//    const double aPos[3] = { vPos(1), vPos(2), vPos(3) };
+//
+//    if (_filter.Changed(IClassicsExtPacket::k_EPacketType_EntityPosition, pen->en_ulID, 0, aPos, 3)) {
+//      ...create, fill and send the packet...
+//      _filter.Commit(IClassicsExtPacket::k_EPacketType_EntityPosition, pen->en_ulID, 0, aPos, 3);
+//    }
+//
+//    void PATCH_CALLTYPE INetworkEvents_OnAddPlayer(CPlayerTarget &plt, BOOL bLocal) {
+//      _filter.Reset();
+//    };
+//================================================================================================//
+
+// Last sent states of entity fields
+struct ExtPacketStateFilter_t
+{
+  // Maximum amount of values per field (e.g. XYZ position with HPB rotation is 6)
+  enum { k_ctMaxValues = 6 };
+
+  // One slot in the open addressing table
+  struct Slot_t {
+    ULONG m_ulType; // Packet type
+    ULONG m_ulEntity; // Entity ID
+    ULONG m_ulField; // Custom field identifier, e.g. property ID or 0/1 for position/rotation
+    bool m_bUsed;
+    bool m_bKnown; // Whether there's a remembered state
+    int m_ctValues;
+    SLONG m_aslValues[k_ctMaxValues]; // Quantized values
+  };
+
+  // Size of one quantization step
+  double m_dQuantum;
+
+  Slot_t *m_aSlots;
+  ULONG m_ctSlots; // Always a power of two
+  ULONG m_ctUsed;
+
+  ExtPacketStateFilter_t(double dQuantum = 1.0 / 1024.0) : m_dQuantum(dQuantum),
+    m_aSlots(NULL), m_ctSlots(0), m_ctUsed(0) {};
+
+  ~ExtPacketStateFilter_t() {
+    delete[] m_aSlots;
+  };
+
+  // Forget all states, so that the next packet of each field is always sent
+  void Reset(void)
+  {
+    delete[] m_aSlots;
+    m_aSlots = NULL;
+    m_ctSlots = 0;
+    m_ctUsed = 0;
+  };
+
+  // Forget states of every field of a specific entity, e.g. after it's been deleted
+  void Forget(ULONG ulEntity)
+  {
+    for (ULONG iSlot = 0; iSlot < m_ctSlots; iSlot++) {
+      if (m_aSlots[iSlot].m_ulEntity == ulEntity) m_aSlots[iSlot].m_bKnown = false;
+    }
+  };
+
+  // Check whether the quantized state of an entity field is different from the last committed one
+  // The state isn't remembered until Commit() is called with it after the packet has been sent
+  bool Changed(ULONG ulType, ULONG ulEntity, ULONG ulField, const double *aValues, int ctValues) const
+  {
+    if (ctValues > k_ctMaxValues) return true;
+
+    SLONG aslValues[k_ctMaxValues];
+    Quantize(aValues, ctValues, aslValues);
+
+    return !IsSame(ulType, ulEntity, ulField, aslValues, ctValues);
+  };
+
+  // Check whether an integer state of an entity field (e.g. flags or a property value) has changed
+  inline bool Changed(ULONG ulType, ULONG ulEntity, ULONG ulField, SLONG slValue) const {
+    return !IsSame(ulType, ulEntity, ulField, &slValue, 1);
+  };
+
+  // Remember the quantized state of an entity field after a packet with it has been sent
+  void Commit(ULONG ulType, ULONG ulEntity, ULONG ulField, const double *aValues, int ctValues)
+  {
+    if (ctValues > k_ctMaxValues) return;
+
+    SLONG aslValues[k_ctMaxValues];
+    Quantize(aValues, ctValues, aslValues);
+
+    Remember(ulType, ulEntity, ulField, aslValues, ctValues);
+  };
+
+  // Remember an integer state of an entity field after a packet with it has been sent
+  inline void Commit(ULONG ulType, ULONG ulEntity, ULONG ulField, SLONG slValue) {
+    Remember(ulType, ulEntity, ulField, &slValue, 1);
+  };
+
+private:
+  // Convert values into amounts of quantization steps
+  void Quantize(const double *aValues, int ctValues, SLONG *aslValues) const
+  {
+    for (int iValue = 0; iValue < ctValues; iValue++) {
+      const double dSteps = aValues[iValue] / m_dQuantum;
+      double dRounded = (dSteps < 0.0 ? dSteps - 0.5 : dSteps + 0.5);
+
+      // Clamp values that don't fit into the integer range (including NaN) before converting them
+      if (!(dRounded > -2147483648.0)) {
+        dRounded = -2147483648.0;
+      } else if (dRounded > 2147483647.0) {
+        dRounded = 2147483647.0;
+      }
+
+      aslValues[iValue] = SLONG(dRounded);
+    }
+  };
+
+  // Check whether quantized values match the committed state of a field
+  bool IsSame(ULONG ulType, ULONG ulEntity, ULONG ulField, const SLONG *aslValues, int ctValues) const
+  {
+    if (m_ctSlots == 0) return false;
+
+    ULONG iSlot = Hash(ulType, ulEntity, ulField) & (m_ctSlots - 1);
+
+    for (;; iSlot = (iSlot + 1) & (m_ctSlots - 1)) {
+      const Slot_t &slot = m_aSlots[iSlot];
+
+      if (!slot.m_bUsed) return false;
+
+      if (slot.m_ulEntity == ulEntity && slot.m_ulType == ulType && slot.m_ulField == ulField) {
+        return (slot.m_bKnown && slot.m_ctValues == ctValues
+          && memcmp(slot.m_aslValues, aslValues, sizeof(SLONG) * ctValues) == 0);
+      }
+    }
+  };
+
+  // Replace the committed state of a field
+  void Remember(ULONG ulType, ULONG ulEntity, ULONG ulField, const SLONG *aslValues, int ctValues)
+  {
+    Slot_t &slot = FindSlot(ulType, ulEntity, ulField);
+
+    slot.m_bKnown = true;
+    slot.m_ctValues = ctValues;
+    memcpy(slot.m_aslValues, aslValues, sizeof(SLONG) * ctValues);
+  };
+
+  static inline ULONG Hash(ULONG ulType, ULONG ulEntity, ULONG ulField) {
+    return ((ulEntity * 2654435761UL) ^ (ulType * 2246822519UL) ^ (ulField * 3266489917UL)) & 0xFFFFFFFF;
+  };
+
+  // Find slot of a specific field or add a new one
+  Slot_t &FindSlot(ULONG ulType, ULONG ulEntity, ULONG ulField)
+  {
+    // Keep the table at most half full
+    if ((m_ctUsed + 1) * 2 > m_ctSlots) Grow();
+
+    ULONG iSlot = Hash(ulType, ulEntity, ulField) & (m_ctSlots - 1);
+
+    for (;; iSlot = (iSlot + 1) & (m_ctSlots - 1)) {
+      Slot_t &slot = m_aSlots[iSlot];
+
+      if (!slot.m_bUsed) break;
+      if (slot.m_ulEntity == ulEntity && slot.m_ulType == ulType && slot.m_ulField == ulField) return slot;
+    }
+
+    Slot_t &slot = m_aSlots[iSlot];
+    slot.m_ulType = ulType;
+    slot.m_ulEntity = ulEntity;
+    slot.m_ulField = ulField;
+    slot.m_bUsed = true;
+    slot.m_bKnown = false;
+    m_ctUsed++;
+
+    return slot;
+  };
+
+  // Double the table size and reinsert remembered states
+  void Grow(void)
+  {
+    Slot_t *aOldSlots = m_aSlots;
+    const ULONG ctOldSlots = m_ctSlots;
+
+    m_ctSlots = (ctOldSlots == 0) ? 256 : ctOldSlots * 2;
+    m_aSlots = new Slot_t[m_ctSlots];
+    memset(m_aSlots, 0, sizeof(Slot_t) * m_ctSlots);
+    m_ctUsed = 0;
+
+    for (ULONG iOld = 0; iOld < ctOldSlots; iOld++) {
+      const Slot_t &old = aOldSlots[iOld];
+      if (!old.m_bUsed) continue;
+
+      ULONG iSlot = Hash(old.m_ulType, old.m_ulEntity, old.m_ulField) & (m_ctSlots - 1);
+      while (m_aSlots[iSlot].m_bUsed) iSlot = (iSlot + 1) & (m_ctSlots - 1);
+
+      m_aSlots[iSlot] = old;
+      m_ctUsed++;
+    }
+
+    delete[] aOldSlots;
+  };
+
+  // Filters own their tables and cannot be copied
+  ExtPacketStateFilter_t(const ExtPacketStateFilter_t &);
+  ExtPacketStateFilter_t &operator=(const ExtPacketStateFilter_t &);
+};
+
 //================================================================================================//
 // Virtual Classics Patch API
 //================================================================================================//
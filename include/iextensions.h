@@ -25,6 +25,251 @@ PATCH_API HPatchPlugin PATCH_CALLTYPE ClassicsExtensions_GetExtensionByIndex(int
 // Retrieve a specific extension by its identifier
 PATCH_API HPatchPlugin PATCH_CALLTYPE ClassicsExtensions_GetExtensionByName(const char *strExtension);
 
+// Module-local cache of extension handles by their identifiers (don't use directly)
+//
+// Every time the list of available extensions is found to be different, the cache is cleared and
+// its generation is increased, which invalidates all previously retrieved ExtensionHandle_t handles.
+// The list is remembered upon first use without increasing the generation.
+//
+// The generation isn't counted by Classics Patch itself. It's deduced by comparing handles of available
+// extensions, which are addresses of internal plugin modules, so an extension that is unloaded and then
+// loaded again at the same address between two updates cannot be told apart from the old one.
+struct ExtensionHandleCache_t
+{
+  // One slot in the open addressing table
+  struct Slot_t {
+    ULONG m_ulHash;
+    char *m_strExtension; // NULL if the slot is free
+    HPatchPlugin m_hPlugin; // NULL if the extension is unavailable
+  };
+
+  ULONG m_ulGeneration;
+
+  // Available extensions during the last update
+  HPatchPlugin *m_aExtensions;
+  int m_ctExtensions;
+  bool m_bListed; // Whether the list has been remembered yet
+
+  Slot_t *m_aSlots;
+  ULONG m_ctSlots; // Always a power of two
+  ULONG m_ctUsed;
+
+  ExtensionHandleCache_t() : m_ulGeneration(1), m_aExtensions(NULL), m_ctExtensions(0), m_bListed(false),
+    m_aSlots(NULL), m_ctSlots(0), m_ctUsed(0) {};
+
+  ~ExtensionHandleCache_t() {
+    Clear();
+    delete[] m_aExtensions;
+  };
+
+  // Forget all cached handles
+  void Clear(void)
+  {
+    for (ULONG iSlot = 0; iSlot < m_ctSlots; iSlot++) {
+      delete[] m_aSlots[iSlot].m_strExtension;
+    }
+
+    delete[] m_aSlots;
+    m_aSlots = NULL;
+    m_ctSlots = 0;
+    m_ctUsed = 0;
+  };
+
+  // Check whether the list of available extensions has changed and invalidate all handles if it has
+  // Returns true if the handles have been invalidated
+  bool Update(void)
+  {
+    // Nothing could have been retrieved before the first list
+    if (!m_bListed) {
+      Remember();
+      return false;
+    }
+
+    const int ctExtensions = ClassicsExtensions_GetExtensionCount();
+    bool bChanged = (ctExtensions != m_ctExtensions);
+
+    if (!bChanged) {
+      for (int i = 0; i < ctExtensions; i++) {
+        if (m_aExtensions[i] != ClassicsExtensions_GetExtensionByIndex(i)) {
+          bChanged = true;
+          break;
+        }
+      }
+    }
+
+    if (!bChanged) return false;
+
+    Invalidate();
+    return true;
+  };
+
+  // Invalidate all handles unconditionally
+  void Invalidate(void)
+  {
+    Remember();
+    Clear();
+    m_ulGeneration++;
+  };
+
+  // Check whether an extension was available during the last update
+  bool Contains(HPatchPlugin hPlugin) const
+  {
+    if (hPlugin == NULL) return false;
+
+    for (int i = 0; i < m_ctExtensions; i++) {
+      if (m_aExtensions[i] == hPlugin) return true;
+    }
+
+    return false;
+  };
+
+  // Find extension handle by its identifier, looking it up only if it hasn't been cached yet
+  HPatchPlugin Find(const char *strExtension)
+  {
+    if (!m_bListed) Remember();
+
+    const ULONG ulHash = MakeNameHash(strExtension);
+
+    if (m_ctSlots != 0) {
+      for (ULONG iSlot = ulHash & (m_ctSlots - 1);; iSlot = (iSlot + 1) & (m_ctSlots - 1)) {
+        const Slot_t &slot = m_aSlots[iSlot];
+
+        if (slot.m_strExtension == NULL) break;
+        if (slot.m_ulHash == ulHash && strcmp(slot.m_strExtension, strExtension) == 0) return slot.m_hPlugin;
+      }
+    }
+
+    // Cache the result even if the extension is unavailable
+    HPatchPlugin hPlugin = ClassicsExtensions_GetExtensionByName(strExtension);
+
+    if ((m_ctUsed + 1) * 2 > m_ctSlots) Grow();
+
+    ULONG iSlot = ulHash & (m_ctSlots - 1);
+    while (m_aSlots[iSlot].m_strExtension != NULL) iSlot = (iSlot + 1) & (m_ctSlots - 1);
+
+    Slot_t &slot = m_aSlots[iSlot];
+    slot.m_ulHash = ulHash;
+    slot.m_strExtension = new char[strlen(strExtension) + 1];
+    strcpy(slot.m_strExtension, strExtension);
+    slot.m_hPlugin = hPlugin;
+    m_ctUsed++;
+
+    return hPlugin;
+  };
+
+private:
+  // Remember currently available extensions
+  void Remember(void)
+  {
+    const int ctExtensions = ClassicsExtensions_GetExtensionCount();
+
+    delete[] m_aExtensions;
+    m_aExtensions = (ctExtensions > 0) ? new HPatchPlugin[ctExtensions] : NULL;
+    m_ctExtensions = (ctExtensions > 0) ? ctExtensions : 0;
+    m_bListed = true;
+
+    for (int i = 0; i < m_ctExtensions; i++) {
+      m_aExtensions[i] = ClassicsExtensions_GetExtensionByIndex(i);
+    }
+  };
+
+  // Double the size of the table
+  void Grow(void)
+  {
+    Slot_t *aOldSlots = m_aSlots;
+    const ULONG ctOldSlots = m_ctSlots;
+
+    m_ctSlots = (ctOldSlots == 0) ? 16 : ctOldSlots * 2;
+    m_aSlots = new Slot_t[m_ctSlots];
+    memset(m_aSlots, 0, sizeof(Slot_t) * m_ctSlots);
+
+    for (ULONG iOld = 0; iOld < ctOldSlots; iOld++) {
+      if (aOldSlots[iOld].m_strExtension == NULL) continue;
+
+      ULONG iSlot = aOldSlots[iOld].m_ulHash & (m_ctSlots - 1);
+      while (m_aSlots[iSlot].m_strExtension != NULL) iSlot = (iSlot + 1) & (m_ctSlots - 1);
+
+      m_aSlots[iSlot] = aOldSlots[iOld];
+    }
+
+    delete[] aOldSlots;
+  };
+
+  ExtensionHandleCache_t(const ExtensionHandleCache_t &);
+  ExtensionHandleCache_t &operator=(const ExtensionHandleCache_t &);
+};
+
+// Get extension handle cache of the current module (don't use directly)
+inline ExtensionHandleCache_t &ClassicsExtensions_HandleCache(void) {
+  static ExtensionHandleCache_t _cache;
+  return _cache;
+};
+
+// Get current generation of extension handles
+// It only changes when ClassicsExtensions_UpdateHandles() finds the list of available extensions to be
+// different or when ClassicsExtensions_InvalidateHandles() is called
+inline ULONG ClassicsExtensions_GetGeneration(void) {
+  ExtensionHandleCache_t &cache = ClassicsExtensions_HandleCache();
+
+  // Remember the list before anything is cached with the current generation, so that the next update
+  // can compare it against something
+  if (!cache.m_bListed) cache.Update();
+
+  return cache.m_ulGeneration;
+};
+
+// Check whether the list of available extensions has changed (e.g. after plugins have been reloaded)
+// and invalidate all previously retrieved ExtensionHandle_t handles if it has
+//
+// Nothing calls this function automatically. Every module that caches extension handles, signals or
+// properties must call it itself once per tick (e.g. from IProcessingEvents::OnStep) and after anything
+// that may load or unload plugins. Until then, all cached data is considered valid.
+//
+// NOTE: Extensions that have been reloaded at the same address between two calls aren't detected,
+// so ClassicsExtensions_InvalidateHandles() should be called when plugins are known to be reloaded.
+// Returns true if the handles have been invalidated
+inline bool ClassicsExtensions_UpdateHandles(void) {
+  return ClassicsExtensions_HandleCache().Update();
+};
+
+// Invalidate all previously retrieved ExtensionHandle_t handles regardless of available extensions
+inline void ClassicsExtensions_InvalidateHandles(void) {
+  ClassicsExtensions_HandleCache().Invalidate();
+};
+
+// Extension handle that can be safely cached and cheaply validated before use
+struct ExtensionHandle_t
+{
+  HPatchPlugin m_hPlugin;
+  ULONG m_ulGeneration; // Generation of extension handles that it has been retrieved during
+
+  ExtensionHandle_t() : m_hPlugin(NULL), m_ulGeneration(0) {};
+  ExtensionHandle_t(HPatchPlugin hPlugin, ULONG ulGeneration) : m_hPlugin(hPlugin), m_ulGeneration(ulGeneration) {};
+
+  // Check whether the extension is available and the list of extensions hasn't changed since retrieving it
+  // The list is only checked by ClassicsExtensions_UpdateHandles(), which should be called every tick
+  inline bool IsValid(void) const {
+    return (m_hPlugin != NULL && m_ulGeneration == ClassicsExtensions_GetGeneration());
+  };
+
+  inline operator HPatchPlugin() const {
+    return m_hPlugin;
+  };
+};
+
+// Retrieve a specific extension by its identifier using the cache of the current module
+// Unlike ClassicsExtensions_GetExtensionByName(), each identifier is only looked up once per generation
+// Example usage:
+//    static ExtensionHandle_t _hFundomizer;
+//
+//    if (!_hFundomizer.IsValid()) {
+//      _hFundomizer = ClassicsExtensions_GetHandle("PATCH_EXT_fundomizer");
+//    }
+inline ExtensionHandle_t ClassicsExtensions_GetHandle(const char *strExtension) {
+  ExtensionHandleCache_t &cache = ClassicsExtensions_HandleCache();
+  return ExtensionHandle_t(cache.Find(strExtension), cache.m_ulGeneration);
+};
+
 // One extension property in the array
 struct ExtensionProp_t
 {
@@ -66,6 +311,271 @@ PATCH_API ExtensionProp_t *PATCH_CALLTYPE ClassicsExtensions_FindProperty(HPatch
 // because it immediately skips properties with mismatching types without comparing name strings.
 PATCH_API ExtensionProp_t *PATCH_CALLTYPE ClassicsExtensions_FindPropertyOfType(HPatchPlugin hPlugin, const char *strProperty, ExtensionProp_t::EType eType);
 
+// Intermediate structure for hashing string literals character by character (don't use)
+// Every step is inlined, so optimizing compilers fold the entire hash of a literal into a constant
+template<size_t Length>
+struct ExtensionPropKeyHash_t {
+  static inline ULONG Calc(const char *str, ULONG ulHash) {
+    if (*str == '\0') return ulHash;
+    return ExtensionPropKeyHash_t<Length - 1>::Calc(str + 1, ((ulHash ^ (UBYTE)*str) * 16777619UL) & 0xFFFFFFFFUL);
+  };
+};
+
+template<>
+struct ExtensionPropKeyHash_t<0> {
+  static inline ULONG Calc(const char *str, ULONG ulHash) { return ulHash; };
+};
+
+// Name of an extension property coupled with its hash that matches MakeNameHash()
+// When constructed from a string literal, the hash is computed at compile time
+// Example usage:
+//    static const ExtensionPropKey_t _keyMyInt("my_int_property");
+struct ExtensionPropKey_t
+{
+  const char *m_strName;
+  ULONG m_ulHash;
+
+  // Constructor from a string literal
+  template<size_t Length> inline
+  ExtensionPropKey_t(const char (&strName)[Length]) :
+    m_strName(strName), m_ulHash(ExtensionPropKeyHash_t<Length - 1>::Calc(strName, 2166136261UL)) {};
+
+  // Constructor from a string that isn't known at compile time
+  ExtensionPropKey_t(const char *strName, ULONG ulHash) : m_strName(strName), m_ulHash(ulHash) {};
+};
+
+// Hash index of extension properties for looking them up in constant time using name hashes
+//
+// It can be built over an entire array of properties at once (e.g. over EXTENSIONMODULE_PROPSARRAY from
+// within the extension itself upon startup) or it can be bound to some extension handle, in which case
+// properties that aren't indexed yet are looked up using ClassicsExtensions_FindProperty() only once and
+// then remembered for all subsequent lookups. Names of properties that don't exist in the extension are
+// remembered as well, until the index is cleared or bound to another extension.
+//
+// Bound indices forget everything once the generation of extension handles changes (see
+// ClassicsExtensions_UpdateHandles()), so they never return properties of unloaded extensions.
+// Indices bound by an extension identifier look up the handle of the reloaded extension afterwards.
+// Example usage:
+//    static ExtensionPropIndex_t _props;
+//    static const ULONG _ulMyInt = MakeNameHash("my_int_property");
+//
+//    // Inside CLASSICSPATCH_PLUGIN_STARTUP
+//    _props.SetExtensionByName("PATCH_EXT_fundomizer");
+//
+//    // Anywhere afterwards
+//    ExtensionProp_t *pProp = _props.Find(_ulMyInt, "my_int_property");
+struct ExtensionPropIndex_t
+{
+  // One slot in the open addressing table
+  struct Slot_t {
+    ULONG m_ulHash;
+    ExtensionProp_t *m_pProp; // NULL if the slot is free or the property is missing
+    char *m_strMissing; // Name of a missing property (NULL if the slot is free or the property exists)
+
+    inline bool IsFree(void) const {
+      return m_pProp == NULL && m_strMissing == NULL;
+    };
+  };
+
+  // Extension to look up unindexed properties in (may be NULL)
+  HPatchPlugin m_hExtension;
+
+  // Extension identifier (NULL if bound by handle) for looking the extension up again
+  const char *m_strExtension;
+
+  // Generation of extension handles that the properties have been indexed during
+  ULONG m_ulGeneration;
+
+  Slot_t *m_aSlots;
+  ULONG m_ctSlots; // Always a power of two
+  ULONG m_ctUsed;
+
+  // Default constructor for later setup via SetExtension() or Build()
+  ExtensionPropIndex_t() : m_hExtension(NULL), m_strExtension(NULL), m_ulGeneration(0),
+    m_aSlots(NULL), m_ctSlots(0), m_ctUsed(0) {};
+
+  // Constructor that binds the index to some extension
+  ExtensionPropIndex_t(HPatchPlugin hExtension) : m_hExtension(hExtension), m_strExtension(NULL), m_ulGeneration(0),
+    m_aSlots(NULL), m_ctSlots(0), m_ctUsed(0) {};
+
+  ~ExtensionPropIndex_t() {
+    Clear();
+  };
+
+  // Remove all indexed properties
+  void Clear(void)
+  {
+    for (ULONG iSlot = 0; iSlot < m_ctSlots; iSlot++) {
+      delete[] m_aSlots[iSlot].m_strMissing;
+    }
+
+    delete[] m_aSlots;
+    m_aSlots = NULL;
+    m_ctSlots = 0;
+    m_ctUsed = 0;
+  };
+
+  // Bind the index to another extension and forget all previously indexed properties
+  void SetExtension(HPatchPlugin hExtension)
+  {
+    Clear();
+    m_hExtension = hExtension;
+    m_strExtension = NULL;
+    m_ulGeneration = 0;
+  };
+
+  // Bind the index to an extension with a specific identifier and forget all previously indexed properties
+  // The identifier is referenced for looking up the extension again after reloading it, so it should be a string literal
+  void SetExtensionByName(const char *strExtension)
+  {
+    Clear();
+    m_hExtension = NULL;
+    m_strExtension = strExtension;
+    m_ulGeneration = 0;
+  };
+
+  // Forget all indexed properties of the bound extension if the generation of extension handles has changed
+  inline void Validate(void)
+  {
+    if (m_hExtension == NULL && m_strExtension == NULL) return;
+    if (m_ulGeneration != ClassicsExtensions_GetGeneration()) Rebind();
+  };
+
+  // Index every property from an array
+  void Build(ExtensionProp_t *aProps, size_t ctProps)
+  {
+    Clear();
+    Reserve((ULONG)ctProps);
+
+    for (size_t iProp = 0; iProp < ctProps; iProp++) {
+      Add(&aProps[iProp]);
+    }
+  };
+
+  // Make sure that the table can fit a specific amount of properties without rehashing
+  void Reserve(ULONG ctProps)
+  {
+    // Keep the table at most half full
+    ULONG ctNewSlots = 16;
+    while (ctNewSlots < ctProps * 2) ctNewSlots <<= 1;
+
+    if (ctNewSlots <= m_ctSlots) return;
+
+    Slot_t *aOldSlots = m_aSlots;
+    const ULONG ctOldSlots = m_ctSlots;
+
+    m_aSlots = new Slot_t[ctNewSlots];
+    memset(m_aSlots, 0, sizeof(Slot_t) * ctNewSlots);
+    m_ctSlots = ctNewSlots;
+    m_ctUsed = 0;
+
+    // Reinsert existing properties and names of missing ones
+    for (ULONG iSlot = 0; iSlot < ctOldSlots; iSlot++) {
+      const Slot_t &slot = aOldSlots[iSlot];
+      if (!slot.IsFree()) Insert(slot.m_ulHash, slot.m_pProp, slot.m_strMissing);
+    }
+
+    delete[] aOldSlots;
+  };
+
+  // Add one property to the index
+  void Add(ExtensionProp_t *pProp)
+  {
+    if ((m_ctUsed + 1) * 2 > m_ctSlots) Reserve(m_ctUsed + 1);
+    Insert(MakeNameHash(pProp->m_strProperty), pProp, NULL);
+  };
+
+  // Find a property by its name hash and its name, which is used for resolving hash collisions
+  // If the property isn't indexed yet, it's looked up in the bound extension and added to the index
+  // Returns NULL if not found
+  ExtensionProp_t *Find(ULONG ulHash, const char *strProperty)
+  {
+    Validate();
+
+    if (m_ctSlots != 0) {
+      for (ULONG iSlot = ulHash & (m_ctSlots - 1);; iSlot = (iSlot + 1) & (m_ctSlots - 1)) {
+        const Slot_t &slot = m_aSlots[iSlot];
+
+        if (slot.IsFree()) break;
+        if (slot.m_ulHash != ulHash) continue;
+
+        // Already known to be missing
+        if (slot.m_pProp == NULL) {
+          if (strcmp(slot.m_strMissing, strProperty) == 0) return NULL;
+
+        } else if (strcmp(slot.m_pProp->m_strProperty, strProperty) == 0) {
+          return slot.m_pProp;
+        }
+      }
+    }
+
+    // Not indexed yet
+    if (m_hExtension == NULL) return NULL;
+
+    ExtensionProp_t *pProp = ClassicsExtensions_FindProperty(m_hExtension, strProperty);
+
+    if (pProp != NULL) {
+      Add(pProp);
+
+    // Remember the name to avoid looking it up again
+    } else {
+      if ((m_ctUsed + 1) * 2 > m_ctSlots) Reserve(m_ctUsed + 1);
+
+      char *strMissing = new char[strlen(strProperty) + 1];
+      strcpy(strMissing, strProperty);
+      Insert(ulHash, NULL, strMissing);
+    }
+
+    return pProp;
+  };
+
+  // Find a property of a specific type by its name hash and its name; returns NULL if not found
+  ExtensionProp_t *FindOfType(ULONG ulHash, const char *strProperty, ExtensionProp_t::EType eType)
+  {
+    ExtensionProp_t *pProp = Find(ulHash, strProperty);
+
+    if (pProp == NULL || pProp->m_eType != eType) return NULL;
+    return pProp;
+  };
+
+  // Find a property using a precomputed key; returns NULL if not found
+  inline ExtensionProp_t *Find(const ExtensionPropKey_t &key) {
+    return Find(key.m_ulHash, key.m_strName);
+  };
+
+private:
+  void Rebind(void)
+  {
+    Clear();
+
+    if (m_strExtension != NULL) {
+      m_hExtension = ClassicsExtensions_GetHandle(m_strExtension);
+
+    } else if (!ClassicsExtensions_HandleCache().Contains(m_hExtension)) {
+      // Forget extensions that aren't available anymore
+      m_hExtension = NULL;
+    }
+
+    m_ulGeneration = ClassicsExtensions_GetGeneration();
+  };
+
+  // Put a property or a name of a missing one into the first free slot without checking the load
+  void Insert(ULONG ulHash, ExtensionProp_t *pProp, char *strMissing)
+  {
+    ULONG iSlot = ulHash & (m_ctSlots - 1);
+    while (!m_aSlots[iSlot].IsFree()) iSlot = (iSlot + 1) & (m_ctSlots - 1);
+
+    m_aSlots[iSlot].m_ulHash = ulHash;
+    m_aSlots[iSlot].m_pProp = pProp;
+    m_aSlots[iSlot].m_strMissing = strMissing;
+    m_ctUsed++;
+  };
+
+  // Indices own their tables and cannot be copied
+  ExtensionPropIndex_t(const ExtensionPropIndex_t &);
+  ExtensionPropIndex_t &operator=(const ExtensionPropIndex_t &);
+};
+
 // Retrieve a boolean value from some extension property
 // Returns false if the property for this value type cannot be found
 PATCH_API bool PATCH_CALLTYPE ClassicsExtensions_GetBool(HPatchPlugin hPlugin, const char *strProperty, bool *pValue);
@@ -205,35 +715,800 @@ struct ExtensionPropRef_t {
 };
 
 // Setup for boolean properties
-inline void ExtensionPropRef_t<bool>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
+template<> inline void ExtensionPropRef_t<bool>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
   m_hExtension = hExtension; m_strProperty = strProperty; m_ePropType = ExtensionProp_t::k_EType_Bool; m_pValue = NULL;
 };
 
 // Setup for integer properties
-inline void ExtensionPropRef_t<int>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
+template<> inline void ExtensionPropRef_t<int>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
   m_hExtension = hExtension; m_strProperty = strProperty; m_ePropType = ExtensionProp_t::k_EType_Int; m_pValue = NULL;
 };
 
 // Setup for float properties
-inline void ExtensionPropRef_t<float>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
+template<> inline void ExtensionPropRef_t<float>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
   m_hExtension = hExtension; m_strProperty = strProperty; m_ePropType = ExtensionProp_t::k_EType_Float; m_pValue = NULL;
 };
 
 // Setup for double properties
-inline void ExtensionPropRef_t<double>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
+template<> inline void ExtensionPropRef_t<double>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
   m_hExtension = hExtension; m_strProperty = strProperty; m_ePropType = ExtensionProp_t::k_EType_Double; m_pValue = NULL;
 };
 
 // Setup for string properties
-inline void ExtensionPropRef_t<const char *>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
+template<> inline void ExtensionPropRef_t<const char *>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
   m_hExtension = hExtension; m_strProperty = strProperty; m_ePropType = ExtensionProp_t::k_EType_String; m_pValue = NULL;
 };
 
 // Setup for data properties
-inline void ExtensionPropRef_t<void *>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
+template<> inline void ExtensionPropRef_t<void *>::SetupReference(HPatchPlugin hExtension, const char *strProperty) {
   m_hExtension = hExtension; m_strProperty = strProperty; m_ePropType = ExtensionProp_t::k_EType_Data; m_pValue = NULL;
 };
 
+// Property type that matches the template argument of property references (don't use)
+template<class Type> struct ExtensionPropTypeOf_t;
+template<> struct ExtensionPropTypeOf_t<bool>         { enum { k_eType = ExtensionProp_t::k_EType_Bool   }; };
+template<> struct ExtensionPropTypeOf_t<int>          { enum { k_eType = ExtensionProp_t::k_EType_Int    }; };
+template<> struct ExtensionPropTypeOf_t<float>        { enum { k_eType = ExtensionProp_t::k_EType_Float  }; };
+template<> struct ExtensionPropTypeOf_t<double>       { enum { k_eType = ExtensionProp_t::k_EType_Double }; };
+template<> struct ExtensionPropTypeOf_t<const char *> { enum { k_eType = ExtensionProp_t::k_EType_String }; };
+template<> struct ExtensionPropTypeOf_t<void *>       { enum { k_eType = ExtensionProp_t::k_EType_Data   }; };
+
+// Untyped part of a declared property reference (see ExtensionPropDecl_t)
+struct ExtensionPropDeclBase_t
+{
+  const char *m_strExtension; // Identifier of the extension that should contain this property
+  ExtensionPropKey_t m_key;
+  ExtensionProp_t::EType m_eType;
+
+  // Value of the found property or the fallback value, if it hasn't been found
+  void *m_pValue;
+  void *m_pFallback;
+
+  // Next declared property in the registry
+  ExtensionPropDeclBase_t *m_pNext;
+
+  // First declared property in the registry of the current module
+  static inline ExtensionPropDeclBase_t *&Head(void) {
+    static ExtensionPropDeclBase_t *_pHead = NULL;
+    return _pHead;
+  };
+
+  // Generation of extension handles that declared properties have been resolved during (0 if never)
+  static inline ULONG &ResolvedGeneration(void) {
+    static ULONG _ulGeneration = 0;
+    return _ulGeneration;
+  };
+
+  ExtensionPropDeclBase_t(const char *strExtension, const ExtensionPropKey_t &key, ExtensionProp_t::EType eType, void *pFallback) :
+    m_strExtension(strExtension), m_key(key), m_eType(eType), m_pValue(pFallback), m_pFallback(pFallback)
+  {
+    m_pNext = Head();
+    Head() = this;
+  };
+
+  ~ExtensionPropDeclBase_t()
+  {
+    for (ExtensionPropDeclBase_t **ppDecl = &Head(); *ppDecl != NULL; ppDecl = &(*ppDecl)->m_pNext) {
+      if (*ppDecl == this) {
+        *ppDecl = m_pNext;
+        break;
+      }
+    }
+  };
+
+  // Check whether the property has been found during the last resolution
+  inline bool IsFound(void) const {
+    return m_pValue != m_pFallback;
+  };
+
+private:
+  // Declared properties are registered by their address and cannot be copied
+  ExtensionPropDeclBase_t(const ExtensionPropDeclBase_t &);
+  ExtensionPropDeclBase_t &operator=(const ExtensionPropDeclBase_t &);
+};
+
+// Property reference that is declared once and resolved together with all other declared references
+// Template argument must be one of the class types supported by ExtensionProp_t
+//
+// Unlike ExtensionPropRef_t, it never looks up the property on its own. Instead, every declared reference
+// in the module is resolved at once by calling ExtensionPropDecls_ResolveAll() (e.g. from within
+// CLASSICSPATCH_PLUGIN_STARTUP), after which each Get() and Set() is a single indirect access.
+// Until the property is found, the accesses are redirected to a local fallback value.
+//
+// Accesses never check whether the extension is still available, so ExtensionPropDecls_Update() should be
+// called right after each ClassicsExtensions_UpdateHandles() call in order to resolve every reference
+// again after extensions are reloaded.
+// Example usage:
+//    // In global scope
+//    static ExtensionPropDecl_t<int> _iMyInt("PATCH_EXT_fundomizer", "my_int_property", 0);
+//
+//    // Inside CLASSICSPATCH_PLUGIN_STARTUP
+//    ClassicsPatchErrMsg strError;
+//    if (ExtensionPropDecls_ResolveAll(&strError) != 0) {
+//      ...report strError...
+//    }
+//
+//    // Inside IProcessingEvents::OnStep
+//    ClassicsExtensions_UpdateHandles();
+//    ExtensionPropDecls_Update();
+//
+//    // Anywhere afterwards
+//    _iMyInt.Set(_iMyInt.Get() + 1);
+template<class Type>
+struct ExtensionPropDecl_t : public ExtensionPropDeclBase_t
+{
+  // Value that's used when the property cannot be found
+  Type m_fallback;
+
+  ExtensionPropDecl_t(const char *strExtension, const ExtensionPropKey_t &key, Type fallback = Type()) :
+    ExtensionPropDeclBase_t(strExtension, key, (ExtensionProp_t::EType)ExtensionPropTypeOf_t<Type>::k_eType, &m_fallback),
+    m_fallback(fallback) {};
+
+  inline Type Get(void) const {
+    return *static_cast<Type *>(m_pValue);
+  };
+
+  inline void Set(Type value) {
+    *static_cast<Type *>(m_pValue) = value;
+  };
+};
+
+// Resolve every declared property reference in the current module
+// Properties are looked up by their precomputed keys, so the same property is only looked up once
+// Returns amount of properties that couldn't be found and lists them in pOutErrMsg (may be NULL)
+inline int ExtensionPropDecls_ResolveAll(ClassicsPatchErrMsg *pOutErrMsg)
+{
+  int ctMissing = 0;
+  if (pOutErrMsg != NULL) (*pOutErrMsg)[0] = '\0';
+
+  ExtensionPropDeclBase_t::ResolvedGeneration() = ClassicsExtensions_GetGeneration();
+
+  const char *strLastExtension = NULL;
+  ExtensionPropIndex_t props;
+
+  for (ExtensionPropDeclBase_t *pDecl = ExtensionPropDeclBase_t::Head(); pDecl != NULL; pDecl = pDecl->m_pNext) {
+    // Declarations of the same extension usually come in a row
+    if (strLastExtension == NULL || strcmp(strLastExtension, pDecl->m_strExtension) != 0) {
+      strLastExtension = pDecl->m_strExtension;
+      props.SetExtensionByName(strLastExtension);
+    }
+
+    ExtensionProp_t *pProp = props.FindOfType(pDecl->m_key.m_ulHash, pDecl->m_key.m_strName, pDecl->m_eType);
+
+    if (pProp != NULL) {
+      pDecl->m_pValue = &pProp->m_value;
+      continue;
+    }
+
+    // Redirect to the fallback value and report the missing property
+    pDecl->m_pValue = pDecl->m_pFallback;
+    ctMissing++;
+
+    if (pOutErrMsg != NULL) {
+      char *strError = *pOutErrMsg;
+
+      if (strError[0] == '\0') {
+        CopyZeroTerminatedString(strError, "Missing extension properties:", k_cchMaxClassicsPatchErrMsg);
+      }
+
+      char strEntry[k_cchMaxClassicsPatchErrMsg];
+      sprintf(strEntry, " %.256s/%.256s", pDecl->m_strExtension, pDecl->m_key.m_strName);
+
+      const size_t ctUsed = strlen(strError);
+      CopyZeroTerminatedString(strError + ctUsed, strEntry, k_cchMaxClassicsPatchErrMsg - ctUsed);
+    }
+  }
+
+  return ctMissing;
+};
+
+// Resolve every declared property reference in the current module again if the generation of extension
+// handles has changed since the last resolution
+// Returns amount of properties that couldn't be found or -1 if nothing has been resolved
+inline int ExtensionPropDecls_Update(void)
+{
+  const ULONG ulResolved = ExtensionPropDeclBase_t::ResolvedGeneration();
+  if (ulResolved == 0 || ulResolved == ClassicsExtensions_GetGeneration()) return -1;
+
+  return ExtensionPropDecls_ResolveAll(NULL);
+};
+
+struct ExtensionPropWatch_t;
+
+// Callback function for reacting to changes of watched extension properties
+typedef void (PATCH_CALLTYPE *FExtensionPropWatch)(ExtensionPropWatch_t &watch, void *pUserData);
+
+// Watcher of some extension property that tracks changes of its value with a sequence counter
+//
+// Every watcher in the module is checked at once by calling ExtensionPropWatches_PollAll() once per tick
+// (e.g. from IProcessingEvents::OnStep), which compares a copy of each value against the current one.
+// Values of every type are compared directly, so changes are noticed no matter which module has made them
+// and how. Changes can then be noticed by comparing a single integer or by getting notified via a callback.
+//
+// Properties that are watched by handle or by identifier are looked up again after the generation of
+// extension handles changes, so ClassicsExtensions_UpdateHandles() should be called before polling in
+// order to never read properties of unloaded extensions.
+//
+// NOTE: String properties are compared by their pointers, so strings that are modified in place
+// without setting a new pointer via ClassicsExtensions_SetString() aren't considered changed.
+// Example usage:
+//    static ExtensionPropWatch_t _watchMyInt;
+//    _watchMyInt.WatchByName("PATCH_EXT_fundomizer", "my_int_property", &OnMyIntChanged, NULL);
+//
+//    // Inside IProcessingEvents::OnStep
+//    ClassicsExtensions_UpdateHandles();
+//    ExtensionPropWatches_PollAll();
+//
+//    // Somewhere else without a callback
+//    static ULONG _ulSeen = 0;
+//    if (_watchMyInt.HasChanged(_ulSeen)) { ... }
+struct ExtensionPropWatch_t
+{
+  // Watched property (may be NULL)
+  ExtensionProp_t *m_pProp;
+
+  // Extension that contains the property (NULL if the property is watched directly)
+  HPatchPlugin m_hExtension;
+
+  // Extension identifier (NULL if watched by handle) and property name for looking the property up again
+  const char *m_strExtension;
+  const char *m_strProperty;
+
+  // Generation of extension handles that the property has been looked up during
+  ULONG m_ulGeneration;
+
+  // Increased every time a change of the value is detected
+  ULONG m_ulSequence;
+
+  // Copy of the property during the last check
+  ExtensionProp_t m_propLast;
+
+  // Optional callback function that is executed after detecting a change
+  FExtensionPropWatch m_pCallback;
+  void *m_pUserData;
+
+  // Next watcher in the registry
+  ExtensionPropWatch_t *m_pNext;
+
+  // First watcher in the registry of the current module
+  static inline ExtensionPropWatch_t *&Head(void) {
+    static ExtensionPropWatch_t *_pHead = NULL;
+    return _pHead;
+  };
+
+  ExtensionPropWatch_t() : m_pProp(NULL), m_hExtension(NULL), m_strExtension(NULL), m_strProperty(NULL),
+    m_ulGeneration(0), m_ulSequence(0), m_propLast("", 0), m_pCallback(NULL), m_pUserData(NULL)
+  {
+    m_pNext = Head();
+    Head() = this;
+  };
+
+  ~ExtensionPropWatch_t()
+  {
+    for (ExtensionPropWatch_t **ppWatch = &Head(); *ppWatch != NULL; ppWatch = &(*ppWatch)->m_pNext) {
+      if (*ppWatch == this) {
+        *ppWatch = m_pNext;
+        break;
+      }
+    }
+  };
+
+  // Start watching some property that outlives the watcher (e.g. from EXTENSIONMODULE_PROPSARRAY)
+  void Watch(ExtensionProp_t *pProp, FExtensionPropWatch pCallback = NULL, void *pUserData = NULL)
+  {
+    m_hExtension = NULL;
+    m_strExtension = NULL;
+    m_strProperty = NULL;
+    m_pCallback = pCallback;
+    m_pUserData = pUserData;
+
+    m_pProp = pProp;
+    Remember();
+  };
+
+  // Start watching a property in a specific extension
+  // The property is lost for good once the extension becomes unavailable
+  void Watch(HPatchPlugin hExtension, const char *strProperty, FExtensionPropWatch pCallback = NULL, void *pUserData = NULL)
+  {
+    m_strExtension = NULL;
+    m_strProperty = strProperty;
+    m_pCallback = pCallback;
+    m_pUserData = pUserData;
+
+    Lookup(hExtension);
+    Remember();
+  };
+
+  // Start watching a property in an extension with a specific identifier
+  // The property is looked up again in the extension with the same identifier after reloading it
+  void WatchByName(const char *strExtension, const char *strProperty, FExtensionPropWatch pCallback = NULL, void *pUserData = NULL)
+  {
+    m_strExtension = strExtension;
+    m_strProperty = strProperty;
+    m_pCallback = pCallback;
+    m_pUserData = pUserData;
+
+    Lookup(ClassicsExtensions_GetHandle(strExtension));
+    Remember();
+  };
+
+  // Check whether the value has changed since the last check
+  // Returns true if it has, after increasing the sequence counter and executing the callback
+  bool Poll(void)
+  {
+    bool bChanged = false;
+
+    // Look the property up again if the generation of extension handles has changed
+    if (m_strProperty != NULL && m_ulGeneration != ClassicsExtensions_GetGeneration()) {
+      ExtensionProp_t *pLastProp = m_pProp;
+
+      if (m_strExtension != NULL) {
+        Lookup(ClassicsExtensions_GetHandle(m_strExtension));
+
+      } else {
+        // Forget extensions that aren't available anymore
+        Lookup(ClassicsExtensions_HandleCache().Contains(m_hExtension) ? m_hExtension : NULL);
+      }
+
+      // Consider a different property to be a change of the value
+      bChanged = (m_pProp != pLastProp);
+    }
+
+    if (m_pProp != NULL && !IsSameValue(*m_pProp, m_propLast)) bChanged = true;
+    if (!bChanged) return false;
+
+    Remember();
+    m_ulSequence++;
+
+    if (m_pCallback != NULL) m_pCallback(*this, m_pUserData);
+    return true;
+  };
+
+  // Check whether the sequence counter differs from the last seen one and update it
+  inline bool HasChanged(ULONG &ulSeenSequence) const
+  {
+    if (ulSeenSequence == m_ulSequence) return false;
+
+    ulSeenSequence = m_ulSequence;
+    return true;
+  };
+
+  // Compare values of two properties of the same type
+  // Floating point values are compared bitwise, so that NaN values aren't considered changed every time
+  static bool IsSameValue(const ExtensionProp_t &prop1, const ExtensionProp_t &prop2)
+  {
+    if (prop1.m_eType != prop2.m_eType) return false;
+
+    switch (prop1.m_eType) {
+      case ExtensionProp_t::k_EType_Bool:   return prop1.m_value._bool == prop2.m_value._bool;
+      case ExtensionProp_t::k_EType_Int:    return prop1.m_value._int == prop2.m_value._int;
+      case ExtensionProp_t::k_EType_Float:  return memcmp(&prop1.m_value._float, &prop2.m_value._float, sizeof(float)) == 0;
+      case ExtensionProp_t::k_EType_Double: return memcmp(&prop1.m_value._double, &prop2.m_value._double, sizeof(double)) == 0;
+      case ExtensionProp_t::k_EType_String: return prop1.m_value._string == prop2.m_value._string;
+      case ExtensionProp_t::k_EType_Data:   return prop1.m_value._data == prop2.m_value._data;
+    }
+
+    return false;
+  };
+
+private:
+  void Lookup(HPatchPlugin hExtension)
+  {
+    m_hExtension = hExtension;
+    m_pProp = (hExtension != NULL && m_strProperty != NULL) ? ClassicsExtensions_FindProperty(hExtension, m_strProperty) : NULL;
+    m_ulGeneration = ClassicsExtensions_GetGeneration();
+  };
+
+  // Remember the current value for comparing against it during the next check
+  inline void Remember(void) {
+    if (m_pProp != NULL) m_propLast = *m_pProp;
+  };
+
+  // Watchers are registered by their address and cannot be copied
+  ExtensionPropWatch_t(const ExtensionPropWatch_t &);
+  ExtensionPropWatch_t &operator=(const ExtensionPropWatch_t &);
+};
+
+// Check every property watcher in the current module for changes
+// Returns amount of properties that have changed since the last check
+inline int ExtensionPropWatches_PollAll(void)
+{
+  int ctChanged = 0;
+
+  for (ExtensionPropWatch_t *pWatch = ExtensionPropWatch_t::Head(); pWatch != NULL; pWatch = pWatch->m_pNext) {
+    if (pWatch->Poll()) ctChanged++;
+  }
+
+  return ctChanged;
+};
+
+//================================================================================================//
+// Property snapshots
+//
+// Snapshots are compact binary blobs that contain values of an entire array of extension properties
+// (e.g. EXTENSIONMODULE_PROPSARRAY of the extension itself), which can be used for saving and
+// restoring the state of an extension in one call instead of getting and setting each property.
+//
+// A snapshot consists of a header, an entry for each property and a table of strings that are copied
+// from property names and string properties. Properties are matched by their names and types upon
+// restoring.
+// Data properties are skipped because they only contain pointers to some memory.
+//================================================================================================//
+
+// Snapshot format identifiers
+const ULONG k_ulExtensionPropSnapshotMagic = 0x53505845; // "EXPS"
+const ULONG k_ulExtensionPropSnapshotVersion = 2;
+
+// Offset of a NULL string
+const ULONG k_ulExtensionPropSnapshotNoString = 0xFFFFFFFF;
+
+// Beginning of every snapshot
+struct ExtensionPropSnapshotHeader_t {
+  ULONG m_ulMagic;
+  ULONG m_ulVersion;
+  ULONG m_ctEntries;
+  ULONG m_ulSize; // Size of the entire snapshot in bytes
+};
+
+// One property in the snapshot
+struct ExtensionPropSnapshotEntry_t {
+  ULONG m_ulHash; // Property name hash that matches MakeNameHash()
+  ULONG m_ulName; // Offset of the property name from the beginning of the snapshot
+  ULONG m_eType; // ExtensionProp_t::EType
+
+  union {
+    bool   _bool;
+    int    _int;
+    float  _float;
+    double _double;
+    ULONG  _string; // Offset of the string from the beginning of the snapshot
+  } m_value;
+};
+
+// Calculate how many bytes a snapshot of some properties takes
+inline size_t ExtensionProps_SnapshotSize(const ExtensionProp_t *aProps, size_t ctProps)
+{
+  size_t ctSize = sizeof(ExtensionPropSnapshotHeader_t);
+
+  for (size_t iProp = 0; iProp < ctProps; iProp++) {
+    const ExtensionProp_t &prop = aProps[iProp];
+    if (prop.m_eType == ExtensionProp_t::k_EType_Data) continue;
+
+    ctSize += sizeof(ExtensionPropSnapshotEntry_t);
+    ctSize += strlen(prop.m_strProperty) + 1;
+
+    if (prop.m_eType == ExtensionProp_t::k_EType_String && prop.m_value._string != NULL) {
+      ctSize += strlen(prop.m_value._string) + 1;
+    }
+  }
+
+  return ctSize;
+};
+
+// Write a snapshot of some properties into a buffer
+// Returns amount of written bytes or 0 if the buffer is too small (see ExtensionProps_SnapshotSize())
+inline size_t ExtensionProps_Snapshot(const ExtensionProp_t *aProps, size_t ctProps, void *pBuffer, size_t ctBufferSize)
+{
+  const size_t ctSize = ExtensionProps_SnapshotSize(aProps, ctProps);
+  if (ctSize > ctBufferSize) return 0;
+
+  UBYTE *pubSnapshot = (UBYTE *)pBuffer;
+  ExtensionPropSnapshotHeader_t *pHeader = (ExtensionPropSnapshotHeader_t *)pubSnapshot;
+  ExtensionPropSnapshotEntry_t *aEntries = (ExtensionPropSnapshotEntry_t *)(pubSnapshot + sizeof(ExtensionPropSnapshotHeader_t));
+
+  ULONG ctEntries = 0;
+
+  // Count entries first to know where the string table begins
+  for (size_t iCount = 0; iCount < ctProps; iCount++) {
+    if (aProps[iCount].m_eType != ExtensionProp_t::k_EType_Data) ctEntries++;
+  }
+
+  size_t iStringOffset = sizeof(ExtensionPropSnapshotHeader_t) + ctEntries * sizeof(ExtensionPropSnapshotEntry_t);
+  ExtensionPropSnapshotEntry_t *pEntry = aEntries;
+
+  for (size_t iProp = 0; iProp < ctProps; iProp++) {
+    const ExtensionProp_t &prop = aProps[iProp];
+    if (prop.m_eType == ExtensionProp_t::k_EType_Data) continue;
+
+    memset(pEntry, 0, sizeof(ExtensionPropSnapshotEntry_t));
+    pEntry->m_ulHash = MakeNameHash(prop.m_strProperty);
+    pEntry->m_eType = prop.m_eType;
+
+    // Copy the name into the table
+    const size_t ctNameLength = strlen(prop.m_strProperty) + 1;
+    memcpy(pubSnapshot + iStringOffset, prop.m_strProperty, ctNameLength);
+
+    pEntry->m_ulName = (ULONG)iStringOffset;
+    iStringOffset += ctNameLength;
+
+    switch (prop.m_eType) {
+      case ExtensionProp_t::k_EType_Bool:   pEntry->m_value._bool   = prop.m_value._bool;   break;
+      case ExtensionProp_t::k_EType_Int:    pEntry->m_value._int    = prop.m_value._int;    break;
+      case ExtensionProp_t::k_EType_Float:  pEntry->m_value._float  = prop.m_value._float;  break;
+      case ExtensionProp_t::k_EType_Double: pEntry->m_value._double = prop.m_value._double; break;
+
+      case ExtensionProp_t::k_EType_String: {
+        if (prop.m_value._string == NULL) {
+          pEntry->m_value._string = k_ulExtensionPropSnapshotNoString;
+          break;
+        }
+
+        // Copy the string into the table
+        const size_t ctLength = strlen(prop.m_value._string) + 1;
+        memcpy(pubSnapshot + iStringOffset, prop.m_value._string, ctLength);
+
+        pEntry->m_value._string = (ULONG)iStringOffset;
+        iStringOffset += ctLength;
+      } break;
+
+      default: break;
+    }
+
+    pEntry++;
+  }
+
+  pHeader->m_ulMagic = k_ulExtensionPropSnapshotMagic;
+  pHeader->m_ulVersion = k_ulExtensionPropSnapshotVersion;
+  pHeader->m_ctEntries = ctEntries;
+  pHeader->m_ulSize = (ULONG)ctSize;
+
+  return ctSize;
+};
+
+// Get a string from the string table of a snapshot
+// Returns NULL if the offset is outside the table or the string isn't terminated within the snapshot
+inline const char *ExtensionProps_SnapshotString(const UBYTE *pubSnapshot, size_t ctEntriesEnd, size_t ctSize, ULONG ulOffset)
+{
+  if (ulOffset < ctEntriesEnd || ulOffset >= ctSize) return NULL;
+
+  const char *str = (const char *)(pubSnapshot + ulOffset);
+  if (memchr(str, '\0', ctSize - ulOffset) == NULL) return NULL;
+
+  return str;
+};
+
+// Restore values of some properties from a snapshot
+// Values of string properties are set to point to the strings inside the snapshot, so the snapshot
+// buffer must stay intact for as long as the restored string values are in use!
+// Returns amount of restored properties or -1 if the snapshot is invalid
+inline int ExtensionProps_Restore(ExtensionProp_t *aProps, size_t ctProps, const void *pSnapshot, size_t ctSnapshotSize)
+{
+  const UBYTE *pubSnapshot = (const UBYTE *)pSnapshot;
+  const ExtensionPropSnapshotHeader_t *pHeader = (const ExtensionPropSnapshotHeader_t *)pubSnapshot;
+
+  // Validate the snapshot
+  if (ctSnapshotSize < sizeof(ExtensionPropSnapshotHeader_t)) return -1;
+  if (pHeader->m_ulMagic != k_ulExtensionPropSnapshotMagic || pHeader->m_ulVersion != k_ulExtensionPropSnapshotVersion) return -1;
+  if (pHeader->m_ulSize > ctSnapshotSize || pHeader->m_ulSize < sizeof(ExtensionPropSnapshotHeader_t)) return -1;
+
+  // Check the amount before multiplying it to avoid overflowing
+  const size_t ctMaxEntries = (pHeader->m_ulSize - sizeof(ExtensionPropSnapshotHeader_t)) / sizeof(ExtensionPropSnapshotEntry_t);
+  if (pHeader->m_ctEntries > ctMaxEntries) return -1;
+
+  const size_t ctEntriesEnd = sizeof(ExtensionPropSnapshotHeader_t) + pHeader->m_ctEntries * sizeof(ExtensionPropSnapshotEntry_t);
+
+  const ExtensionPropSnapshotEntry_t *aEntries = (const ExtensionPropSnapshotEntry_t *)(pubSnapshot + sizeof(ExtensionPropSnapshotHeader_t));
+  int ctRestored = 0;
+  size_t iNextProp = 0;
+
+  for (ULONG iEntry = 0; iEntry < pHeader->m_ctEntries; iEntry++) {
+    const ExtensionPropSnapshotEntry_t &entry = aEntries[iEntry];
+    ExtensionProp_t *pProp = NULL;
+
+    const char *strName = ExtensionProps_SnapshotString(pubSnapshot, ctEntriesEnd, pHeader->m_ulSize, entry.m_ulName);
+    if (strName == NULL) continue; // Corrupted name offset
+
+    // Properties are usually restored into the same array in the same order, so start from the next one
+    for (size_t iCheck = 0; iCheck < ctProps; iCheck++) {
+      ExtensionProp_t &prop = aProps[(iNextProp + iCheck) % ctProps];
+
+      if ((ULONG)prop.m_eType == entry.m_eType && MakeNameHash(prop.m_strProperty) == entry.m_ulHash
+       && strcmp(prop.m_strProperty, strName) == 0) {
+        pProp = &prop;
+        iNextProp = (iNextProp + iCheck + 1) % ctProps;
+        break;
+      }
+    }
+
+    if (pProp == NULL) continue;
+
+    switch (pProp->m_eType) {
+      case ExtensionProp_t::k_EType_Bool:   pProp->m_value._bool   = entry.m_value._bool;   break;
+      case ExtensionProp_t::k_EType_Int:    pProp->m_value._int    = entry.m_value._int;    break;
+      case ExtensionProp_t::k_EType_Float:  pProp->m_value._float  = entry.m_value._float;  break;
+      case ExtensionProp_t::k_EType_Double: pProp->m_value._double = entry.m_value._double; break;
+
+      case ExtensionProp_t::k_EType_String: {
+        const ULONG ulOffset = entry.m_value._string;
+
+        if (ulOffset == k_ulExtensionPropSnapshotNoString) {
+          pProp->m_value._string = NULL;
+
+        } else {
+          const char *strValue = ExtensionProps_SnapshotString(pubSnapshot, ctEntriesEnd, pHeader->m_ulSize, ulOffset);
+          if (strValue == NULL) continue; // Corrupted string offset
+
+          pProp->m_value._string = strValue;
+        }
+      } break;
+
+      default: continue;
+    }
+
+    ctRestored++;
+  }
+
+  return ctRestored;
+};
+
+//================================================================================================//
+// Atomic property access
+//
+// Values of extension properties are plain variables that are normally only accessed from the main
+// thread. The following functions allow accessing them from other threads (e.g. worker threads that
+// gather statistics) without data races, as long as every write to the same property from every
+// thread is also performed through them.
+//
+// Bool, integer, float and data properties are read and written atomically without any locking.
+// Double and string values cannot be accessed like that, so they are guarded by a sequence lock that
+// needs to be shared between all threads (see ExtensionPropSeqLock_t below).
+//================================================================================================//
+
+// Atomically retrieve a boolean value from some extension property
+inline bool ExtensionProp_AtomicGetBool(ExtensionProp_t *pProp) {
+  return (InterlockedCompareExchange((volatile LONG *)&pProp->m_value, 0, 0) & 0xFF) != 0;
+};
+
+// Atomically retrieve an integer value from some extension property
+inline int ExtensionProp_AtomicGetInt(ExtensionProp_t *pProp) {
+  return (int)InterlockedCompareExchange((volatile LONG *)&pProp->m_value._int, 0, 0);
+};
+
+// Atomically retrieve a float value from some extension property
+inline float ExtensionProp_AtomicGetFloat(ExtensionProp_t *pProp) {
+  const LONG lBits = InterlockedCompareExchange((volatile LONG *)&pProp->m_value._float, 0, 0);
+
+  float fValue;
+  memcpy(&fValue, &lBits, sizeof(fValue));
+  return fValue;
+};
+
+// Atomically retrieve a pointer to some data from some extension property
+inline void *ExtensionProp_AtomicGetData(ExtensionProp_t *pProp) {
+  return InterlockedCompareExchangePointer((void *volatile *)&pProp->m_value._data, NULL, NULL);
+};
+
+// Atomically set a boolean value to some extension property
+// The entire first word of the value is rewritten, which is unused by boolean properties anyway
+inline void ExtensionProp_AtomicSetBool(ExtensionProp_t *pProp, bool bValue) {
+  InterlockedExchange((volatile LONG *)&pProp->m_value, bValue ? 1 : 0);
+};
+
+// Atomically set an integer value to some extension property
+inline void ExtensionProp_AtomicSetInt(ExtensionProp_t *pProp, int iValue) {
+  InterlockedExchange((volatile LONG *)&pProp->m_value._int, (LONG)iValue);
+};
+
+// Atomically set a float value to some extension property
+inline void ExtensionProp_AtomicSetFloat(ExtensionProp_t *pProp, float fValue) {
+  LONG lBits;
+  memcpy(&lBits, &fValue, sizeof(fValue));
+  InterlockedExchange((volatile LONG *)&pProp->m_value._float, lBits);
+};
+
+// Atomically set a pointer to some data to some extension property
+inline void ExtensionProp_AtomicSetData(ExtensionProp_t *pProp, void *pValue) {
+  InterlockedExchangePointer((void *volatile *)&pProp->m_value._data, pValue);
+};
+
+// Sequence lock for accessing double and string values of some extension property from multiple threads
+//
+// Writers never wait for readers. Readers retry reading the value until they manage to do it without
+// any writes in between, which is always the case unless the same property is written to constantly.
+//
+// NOTE: String properties only hold pointers to strings, so GetString() copies the string contents.
+// Strings that have been set must not be freed while other threads may still be copying them.
+// Example usage:
+//    // Shared between threads
+//    static ExtensionPropSeqLock_t _lockMyDouble;
+//    _lockMyDouble.m_pProp = ClassicsExtensions_FindProperty(hExtension, "my_double_property");
+//
+//    // On the main thread
+//    _lockMyDouble.SetDouble(1.0);
+//
+//    // On a worker thread
+//    double fValue = _lockMyDouble.GetDouble();
+struct ExtensionPropSeqLock_t
+{
+  // Guarded property
+  ExtensionProp_t *m_pProp;
+
+  // Odd while the value is being written to
+  volatile LONG m_lSequence;
+
+  ExtensionPropSeqLock_t() : m_pProp(NULL), m_lSequence(0) {};
+  ExtensionPropSeqLock_t(ExtensionProp_t *pProp) : m_pProp(pProp), m_lSequence(0) {};
+
+  // Wait for other writers and mark the value as being written to
+  inline void BeginWrite(void) {
+    for (;;) {
+      const LONG lSequence = m_lSequence;
+      if ((lSequence & 1) == 0 && InterlockedCompareExchange(&m_lSequence, lSequence + 1, lSequence) == lSequence) break;
+    }
+  };
+
+  // Mark the value as written
+  inline void EndWrite(void) {
+    InterlockedIncrement(&m_lSequence);
+  };
+
+  // Wait for writers and retrieve the current sequence before reading the value
+  inline LONG BeginRead(void) {
+    for (;;) {
+      const LONG lSequence = InterlockedCompareExchange(&m_lSequence, 0, 0);
+      if ((lSequence & 1) == 0) return lSequence;
+    }
+  };
+
+  // Check whether the value has been read without any writes in between
+  inline bool EndRead(LONG lSequence) {
+    return InterlockedCompareExchange(&m_lSequence, 0, 0) == lSequence;
+  };
+
+  // Set a double value to the property
+  void SetDouble(double fValue)
+  {
+    BeginWrite();
+    m_pProp->m_value._double = fValue;
+    EndWrite();
+  };
+
+  // Retrieve a double value from the property
+  double GetDouble(void)
+  {
+    double fValue;
+    LONG lSequence;
+
+    do {
+      lSequence = BeginRead();
+      fValue = *(volatile double *)&m_pProp->m_value._double;
+    } while (!EndRead(lSequence));
+
+    return fValue;
+  };
+
+  // Set a string value to the property
+  void SetString(const char *strValue)
+  {
+    BeginWrite();
+    m_pProp->m_value._string = strValue;
+    EndWrite();
+  };
+
+  // Copy the string value from the property into a buffer
+  // Returns false if the property has no string (NULL)
+  bool GetString(char *strBuffer, size_t ctBufferSize)
+  {
+    bool bValid;
+    LONG lSequence;
+
+    do {
+      lSequence = BeginRead();
+
+      const char *strValue = *(const char *volatile *)&m_pProp->m_value._string;
+      bValid = (strValue != NULL);
+
+      if (bValid) {
+        CopyZeroTerminatedString(strBuffer, strValue, ctBufferSize);
+      } else {
+        strBuffer[0] = '\0';
+      }
+    } while (!EndRead(lSequence));
+
+    return bValid;
+  };
+};
+
 // Function handler of an extension signal
 // Input data and output value are completely optional and depend on the function implementation
 typedef int (PATCH_CALLTYPE *FExtensionSignal)(void *pOptionalData);
@@ -254,6 +1529,221 @@ PATCH_API FExtensionSignal PATCH_CALLTYPE ClassicsExtensions_FindSignal(HPatchPl
 // pData - optional data that will be passed into the signal call (see FExtensionSignal prototype)
 PATCH_API bool PATCH_CALLTYPE ClassicsExtensions_CallSignal(HPatchPlugin hPlugin, const char *strSignal, int *piResult, void *pData);
 
+// Extension signal that is looked up only once and then called directly by its handler
+// Template argument is the structure that the signal expects a pointer to (see "extensiontypes.h"), which
+// prevents passing mismatching data at compile time. It can be left as 'void' for signals without arguments.
+//
+// Calls don't look up anything. Instead, the signal is looked up again before the next call after the
+// generation of extension handles changes, so ClassicsExtensions_UpdateHandles() should be called once per
+// tick and after loading plugins in order to never call handlers of unloaded extensions. Extension
+// identifiers and signal names are referenced for that purpose, so they should be string literals.
+// Example usage:
+//    static ExtensionSignalRef_t<ExtArgWorldConverter_t> _sigPrepare("PATCH_EXT_wldconverters", "SetMethodPrepare");
+//
+//    ExtArgWorldConverter_t arg;
+//    arg.iID = iConverter;
+//    arg.pData = (void *)&MyConverterPrepare;
+//    _sigPrepare.Call(&arg);
+template<class ArgType = void>
+struct ExtensionSignalRef_t {
+  // Handle to the extension that contains this signal
+  HPatchPlugin m_hExtension;
+
+  // Stable signal identifier (hash of the signal name that matches MakeNameHash())
+  ULONG m_ulID;
+
+  // Handler of the found signal
+  // NULL if the signal cannot be found
+  FExtensionSignal m_pHandler;
+
+  // Extension identifier (NULL if resolved by handle) and signal name for looking the signal up again
+  const char *m_strExtension;
+  const char *m_strSignal;
+
+  // Generation of extension handles that the signal has been looked up during
+  ULONG m_ulGeneration;
+
+  // Default constructor for later setup via Resolve()
+  ExtensionSignalRef_t() : m_hExtension(NULL), m_ulID(0), m_pHandler(NULL),
+    m_strExtension(NULL), m_strSignal(NULL), m_ulGeneration(0) {};
+
+  // Constructor that looks up a signal inside some extension
+  inline ExtensionSignalRef_t(HPatchPlugin hExtension, const char *strSignal) {
+    Resolve(hExtension, strSignal);
+  };
+
+  // Constructor that looks up a signal inside some extension
+  // m_hExtension handle is found by searching for an extension with the matching identifier
+  inline ExtensionSignalRef_t(const char *strExtension, const char *strSignal) {
+    ResolveByName(strExtension, strSignal);
+  };
+
+  // Look up a specific signal in a specific extension
+  // The signal is lost for good once the extension becomes unavailable
+  // Returns false if the signal cannot be found
+  bool Resolve(HPatchPlugin hExtension, const char *strSignal)
+  {
+    m_strExtension = NULL;
+    m_strSignal = strSignal;
+    m_ulID = MakeNameHash(strSignal);
+
+    Lookup(hExtension);
+
+    return (m_pHandler != NULL);
+  };
+
+  // Look up a specific signal in an extension with a specific identifier
+  // The signal is looked up again in the extension with the same identifier after reloading it
+  // Returns false if the signal cannot be found
+  bool ResolveByName(const char *strExtension, const char *strSignal)
+  {
+    m_strExtension = strExtension;
+    m_strSignal = strSignal;
+    m_ulID = MakeNameHash(strSignal);
+
+    Lookup(ClassicsExtensions_GetHandle(strExtension));
+
+    return (m_pHandler != NULL);
+  };
+
+  // Check whether the signal has been found
+  inline bool IsResolved(void) const {
+    return (m_pHandler != NULL);
+  };
+
+  // Look up the signal again if the generation of extension handles has changed since the last lookup
+  inline void Validate(void)
+  {
+    if (m_ulGeneration != ClassicsExtensions_GetGeneration()) Relookup();
+  };
+
+  // Try to call the signal
+  // Returns false if the signal cannot be called (not found)
+  // piResult - pointer to the variable that will hold the result from the function call (may be NULL)
+  inline bool Call(ArgType *pData, int *piResult = NULL)
+  {
+    Validate();
+    if (m_pHandler == NULL) return false;
+
+    const int iResult = m_pHandler((void *)pData);
+    if (piResult != NULL) *piResult = iResult;
+
+    return true;
+  };
+
+private:
+  void Relookup(void)
+  {
+    if (m_strExtension != NULL) {
+      Lookup(ClassicsExtensions_GetHandle(m_strExtension));
+
+    } else {
+      // Forget extensions that aren't available anymore
+      Lookup(ClassicsExtensions_HandleCache().Contains(m_hExtension) ? m_hExtension : NULL);
+    }
+  };
+
+  void Lookup(HPatchPlugin hExtension)
+  {
+    m_hExtension = hExtension;
+    m_pHandler = (hExtension != NULL && m_strSignal != NULL) ? ClassicsExtensions_FindSignal(hExtension, m_strSignal) : NULL;
+    m_ulGeneration = ClassicsExtensions_GetGeneration();
+  };
+};
+
+// Handlers of the same signal from all available extensions for calling every one of them at once
+// Template argument has the same purpose as in ExtensionSignalRef_t
+//
+// Handlers are gathered into a dense array that is only rebuilt after ClassicsExtensions_UpdateHandles()
+// detects any change in the list of available extensions (i.e. after plugins are loaded or unloaded),
+// so calling all of them is a single loop without any lookups. ClassicsExtensions_UpdateHandles() should
+// be called once per tick and after loading plugins in order to never call handlers of unloaded extensions.
+// Example usage:
+//    static ExtensionSignalBroadcast_t<> _sigOnReset("OnReset");
+//    _sigOnReset.Call(NULL);
+template<class ArgType = void>
+struct ExtensionSignalBroadcast_t {
+  // Name of the signal to gather from extensions
+  const char *m_strSignal;
+
+  // Found handlers and extensions they belong to
+  FExtensionSignal *m_aHandlers;
+  HPatchPlugin *m_aExtensions;
+  int m_ctHandlers;
+
+  // Whether the list needs to be rebuilt and generation of extension handles during the last rebuild
+  bool m_bRebuild;
+  ULONG m_ulLastGeneration;
+
+  ExtensionSignalBroadcast_t(const char *strSignal) :
+    m_strSignal(strSignal), m_aHandlers(NULL), m_aExtensions(NULL), m_ctHandlers(0), m_bRebuild(true), m_ulLastGeneration(0) {};
+
+  ~ExtensionSignalBroadcast_t() {
+    Clear();
+  };
+
+  // Remove all gathered handlers and rebuild the list on the next call
+  void Clear(void)
+  {
+    delete[] m_aHandlers;
+    delete[] m_aExtensions;
+    m_aHandlers = NULL;
+    m_aExtensions = NULL;
+    m_ctHandlers = 0;
+    m_bRebuild = true;
+  };
+
+  // Gather handlers of the signal from all available extensions
+  void Rebuild(void)
+  {
+    Clear();
+
+    const int ctExtensions = ClassicsExtensions_GetExtensionCount();
+    m_bRebuild = false;
+    m_ulLastGeneration = ClassicsExtensions_GetGeneration();
+
+    if (ctExtensions <= 0) return;
+
+    m_aHandlers = new FExtensionSignal[ctExtensions];
+    m_aExtensions = new HPatchPlugin[ctExtensions];
+
+    for (int iExtension = 0; iExtension < ctExtensions; iExtension++) {
+      HPatchPlugin hExtension = ClassicsExtensions_GetExtensionByIndex(iExtension);
+      if (hExtension == NULL) continue;
+
+      FExtensionSignal pHandler = ClassicsExtensions_FindSignal(hExtension, m_strSignal);
+      if (pHandler == NULL) continue;
+
+      m_aHandlers[m_ctHandlers] = pHandler;
+      m_aExtensions[m_ctHandlers] = hExtension;
+      m_ctHandlers++;
+    }
+  };
+
+  // Rebuild the list if the generation of extension handles has changed since the last rebuild
+  inline void Update(void) {
+    if (m_bRebuild || ClassicsExtensions_GetGeneration() != m_ulLastGeneration) Rebuild();
+  };
+
+  // Call the signal in every extension that implements it
+  // Returns amount of called handlers
+  int Call(ArgType *pData)
+  {
+    Update();
+
+    for (int i = 0; i < m_ctHandlers; i++) {
+      m_aHandlers[i]((void *)pData);
+    }
+
+    return m_ctHandlers;
+  };
+
+private:
+  // Broadcasts own their arrays and cannot be copied
+  ExtensionSignalBroadcast_t(const ExtensionSignalBroadcast_t &);
+  ExtensionSignalBroadcast_t &operator=(const ExtensionSignalBroadcast_t &);
+};
+
 //================================================================================================//
 // Extension API
 //
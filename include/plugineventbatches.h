@@ -0,0 +1,112 @@
+// Copyright (c) Dreamy Cecil; see copyright notice in LICENSE file
+
+#ifndef CLASSICSPATCH_PLUGINEVENTBATCHES_H
+#define CLASSICSPATCH_PLUGINEVENTBATCHES_H
+#ifdef _WIN32
+  #pragma once
+#endif
+
+#include "classicspatch_common.h"
+#include "pluginevents.h"
+
+//================================================================================================//
+// Batched player actions
+//
+// IPacketEvents::OnPlayerAction is executed separately for each received action of each player,
+// including resent ones. Plugins that analyze actions of all players (e.g. for anti-cheat or stats)
+// can instead collect them into a contiguous array and process the entire array once per tick.
+//
+// The template argument is the player action class, which is CPlayerAction by default. Serious Engine
+// headers are required for the batch to be able to store copies of the actions.
+//
+// Example usage:
+//    static PlayerActionBatch_t<> _batch;
+//
+//    void PATCH_CALLTYPE IPacketEvents_OnPlayerAction(INDEX iClient, INDEX iPlayer, CPlayerAction &pa, INDEX iResent) {
+//      _batch.Add(iClient, iPlayer, pa, iResent);
+//    };
+//
+//    void PATCH_CALLTYPE ITimerEvents_OnTick(void) {
+//      _batch.Flush(); // Calls ProcessAllActions() with every action from this tick
+//    };
+//
+//    CLASSICSPATCH_PLUGIN_STARTUP(HIniConfig props, PluginEvents_t &events) {
+//      _batch.m_pProcess = &ProcessAllActions;
+//      events.m_packet->OnPlayerAction = &IPacketEvents_OnPlayerAction;
+//      events.m_timer->OnTick = &ITimerEvents_OnTick;
+//    };
+//================================================================================================//
+
+// One received player action
+template<class ActionType>
+struct PlayerActionRecord_t {
+  INDEX m_iClient;
+  INDEX m_iPlayer;
+  INDEX m_iResent; // -1 for normal actions and >=0 for resent actions
+  ActionType m_pa;
+};
+
+// Collection of player actions received during one tick
+template<class ActionType = CPlayerAction>
+struct PlayerActionBatch_t
+{
+  typedef PlayerActionRecord_t<ActionType> Record_t;
+
+  // Function for processing all actions in the batch at once
+  typedef void (PATCH_CALLTYPE *FProcess)(const Record_t *aRecords, int ctRecords);
+
+  Record_t *m_aRecords;
+  int m_ctRecords;
+  int m_ctAllocated;
+
+  FProcess m_pProcess;
+
+  PlayerActionBatch_t() : m_aRecords(NULL), m_ctRecords(0), m_ctAllocated(0), m_pProcess(NULL) {};
+
+  ~PlayerActionBatch_t() {
+    delete[] m_aRecords;
+  };
+
+  // Add one action to the batch
+  void Add(INDEX iClient, INDEX iPlayer, const ActionType &pa, INDEX iResent)
+  {
+    // Reallocate once the batch is full, which eventually stops after a few ticks
+    if (m_ctRecords == m_ctAllocated) {
+      const int ctNewAllocated = (m_ctAllocated == 0) ? 64 : m_ctAllocated * 2;
+      Record_t *aNewRecords = new Record_t[ctNewAllocated];
+
+      for (int i = 0; i < m_ctRecords; i++) {
+        aNewRecords[i] = m_aRecords[i];
+      }
+
+      delete[] m_aRecords;
+      m_aRecords = aNewRecords;
+      m_ctAllocated = ctNewAllocated;
+    }
+
+    Record_t &rec = m_aRecords[m_ctRecords++];
+    rec.m_iClient = iClient;
+    rec.m_iPlayer = iPlayer;
+    rec.m_iResent = iResent;
+    rec.m_pa = pa;
+  };
+
+  // Process all collected actions and empty the batch
+  // Returns amount of processed actions
+  int Flush(void)
+  {
+    const int ctRecords = m_ctRecords;
+
+    if (ctRecords != 0 && m_pProcess != NULL) m_pProcess(m_aRecords, ctRecords);
+    m_ctRecords = 0;
+
+    return ctRecords;
+  };
+
+private:
+  // Batches own their arrays and cannot be copied
+  PlayerActionBatch_t(const PlayerActionBatch_t &);
+  PlayerActionBatch_t &operator=(const PlayerActionBatch_t &);
+};
+
+#endif // CLASSICSPATCH_PLUGINEVENTBATCHES_H
@@ -0,0 +1,163 @@
+// Copyright (c) Dreamy Cecil; see copyright notice in LICENSE file
+
+#ifndef CLASSICSPATCH_PLUGINEVENTFILTERS_H
+#define CLASSICSPATCH_PLUGINEVENTFILTERS_H
+#ifdef _WIN32
+  #pragma once
+#endif
+
+#include "classicspatch_common.h"
+
+//================================================================================================//
+// Listener event filters
+//
+// IListenerEvents::OnSendEvent and IListenerEvents::OnCallProcedure are executed for every single
+// event that's being sent or handled by any entity. Plugins that are only interested in a few events
+// or entity classes can use these filters to reject everything else as early as possible.
+//
+// Each filter checks a small bitset first and only performs an exact lookup among the wanted
+// identifiers if the corresponding bit is set, so most unwanted events are rejected by a single
+// memory read.
+//
+// Example usage:
+//    static ListenerEventFilter_t _filter;
+//
+//    void PATCH_CALLTYPE IListenerEvents_OnSendEvent(CEntity *pen, const CEntityEvent &ee) {
+//      if (!_filter.Passes(pen, ee)) return;
+//      ...event code...
+//    };
+//
+//    CLASSICSPATCH_PLUGIN_STARTUP(HIniConfig props, PluginEvents_t &events) {
+//      _filter.m_events.Add(EVENTCODE_EDeath);
+//      _filter.m_events.Add(EVENTCODE_EDamage);
+//      events.m_listener->OnSendEvent = &IListenerEvents_OnSendEvent;
+//    };
+//================================================================================================//
+
+// Set of identifiers (entity class IDs or event codes) with a bitset for quick rejection
+struct ListenerIDSet_t
+{
+  enum { k_ctBits = 2048 };
+
+  // Bits of hashed identifiers
+  UBYTE m_aubBits[k_ctBits / 8];
+
+  // Sorted identifiers for exact lookups
+  SLONG *m_aIDs;
+  int m_ctIDs;
+
+  ListenerIDSet_t() : m_aIDs(NULL), m_ctIDs(0) {
+    memset(m_aubBits, 0, sizeof(m_aubBits));
+  };
+
+  ~ListenerIDSet_t() {
+    delete[] m_aIDs;
+  };
+
+  // Remove all identifiers
+  void Clear(void)
+  {
+    memset(m_aubBits, 0, sizeof(m_aubBits));
+    delete[] m_aIDs;
+    m_aIDs = NULL;
+    m_ctIDs = 0;
+  };
+
+  // Check whether the set has no identifiers
+  inline bool IsEmpty(void) const {
+    return (m_ctIDs == 0);
+  };
+
+  // Bit of some identifier
+  // Event codes hold entity class ID in the upper 16 bits and event index in the lower 16 bits, so both are mixed
+  static inline ULONG GetBit(SLONG slID) {
+    const ULONG ulID = (ULONG)slID;
+    return ((ulID ^ (ulID >> 16) * 31) & (k_ctBits - 1));
+  };
+
+  // Add an identifier
+  void Add(SLONG slID)
+  {
+    if (Contains(slID)) return;
+
+    const ULONG ulBit = GetBit(slID);
+    m_aubBits[ulBit >> 3] |= (1 << (ulBit & 7));
+
+    // Insert while keeping identifiers sorted
+    SLONG *aNewIDs = new SLONG[m_ctIDs + 1];
+    int iInsert = 0;
+
+    while (iInsert < m_ctIDs && m_aIDs[iInsert] < slID) {
+      aNewIDs[iInsert] = m_aIDs[iInsert];
+      iInsert++;
+    }
+
+    aNewIDs[iInsert] = slID;
+
+    for (int i = iInsert; i < m_ctIDs; i++) {
+      aNewIDs[i + 1] = m_aIDs[i];
+    }
+
+    delete[] m_aIDs;
+    m_aIDs = aNewIDs;
+    m_ctIDs++;
+  };
+
+  // Check whether the set contains some identifier
+  bool Contains(SLONG slID) const
+  {
+    const ULONG ulBit = GetBit(slID);
+    if ((m_aubBits[ulBit >> 3] & (1 << (ulBit & 7))) == 0) return false;
+
+    // Binary search
+    int iLow = 0;
+    int iHigh = m_ctIDs - 1;
+
+    while (iLow <= iHigh) {
+      const int iMid = (iLow + iHigh) / 2;
+
+      if (m_aIDs[iMid] == slID) return true;
+
+      if (m_aIDs[iMid] < slID) {
+        iLow = iMid + 1;
+      } else {
+        iHigh = iMid - 1;
+      }
+    }
+
+    return false;
+  };
+
+private:
+  // Sets own their arrays and cannot be copied
+  ListenerIDSet_t(const ListenerIDSet_t &);
+  ListenerIDSet_t &operator=(const ListenerIDSet_t &);
+};
+
+// Filter of entity events by entity class IDs and event codes
+// Empty sets don't filter anything, e.g. a filter with only event codes accepts them from entities of any class
+struct ListenerEventFilter_t
+{
+  ListenerIDSet_t m_classes; // Entity class IDs, i.e. CDLLEntityClass::dec_iID
+  ListenerIDSet_t m_events; // Event codes, i.e. CEntityEvent::ee_slEvent
+
+  // Check whether an event from an entity of some class passes the filter
+  inline bool Passes(SLONG slClassID, SLONG slEvent) const {
+    return (m_events.IsEmpty() || m_events.Contains(slEvent))
+        && (m_classes.IsEmpty() || m_classes.Contains(slClassID));
+  };
+
+  // Check whether an event of some entity passes the filter
+  // Requires Serious Engine headers in order to access the entity and event fields
+  template<class EntityType, class EventType> inline
+  bool Passes(EntityType *pen, const EventType &ee) const
+  {
+    // Event codes are checked first because they don't require dereferencing the entity class
+    if (!m_events.IsEmpty() && !m_events.Contains(ee.ee_slEvent)) return false;
+    if (m_classes.IsEmpty()) return true;
+
+    return m_classes.Contains(pen->GetClass()->ec_pdecDLLClass->dec_iID);
+  };
+};
+
+#endif // CLASSICSPATCH_PLUGINEVENTFILTERS_H
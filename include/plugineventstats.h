@@ -0,0 +1,258 @@
+// Copyright (c) Dreamy Cecil; see copyright notice in LICENSE file
+
+#ifndef CLASSICSPATCH_PLUGINEVENTSTATS_H
+#define CLASSICSPATCH_PLUGINEVENTSTATS_H
+#ifdef _WIN32
+  #pragma once
+#endif
+
+#include "classicspatch_common.h"
+#include "ichat.h"
+
+//================================================================================================//
+// Plugin event statistics
+//
+// Optional instrumentation for measuring how much time plugin event functions take, in order to
+// find out which events of which plugins take up most of the tick. Each measured event function
+// counts its calls and records their durations in a histogram of power-of-two microsecond ranges,
+// from which minimum, average, 99th percentile and maximum durations are reported.
+//
+// Measurements are disabled by default and need to be enabled via PluginEventStats_SetEnabled().
+// While disabled, measured functions only check a single flag upon each call.
+//
+// Example usage:
+//    void PATCH_CALLTYPE IProcessingEvents_OnStep(void) {
+//      PLUGINEVENT_MEASURE("MyPlugin: IProcessingEvents::OnStep");
+//      ...event code...
+//    };
+//
+//    CLASSICSPATCH_PLUGIN_STARTUP(HIniConfig props, PluginEvents_t &events) {
+//      events.m_processing->OnStep = &IProcessingEvents_OnStep;
+//      PluginEventStats_RegisterChatCommand("myplugin_stats");
+//    };
+//================================================================================================//
+
+// Amount of histogram ranges (up to ~35 minutes per call)
+const int k_ctPluginEventStatsBuckets = 32;
+
+// Statistics of a single measured event function
+struct PluginEventStats_t
+{
+  const char *m_strEvent; // Display name of the event
+
+  ULONG m_ctCalls;
+  __int64 m_llTotal; // Total duration of all calls in microseconds
+  __int64 m_llMin;
+  __int64 m_llMax;
+
+  // Amount of calls per duration range
+  // Range 0 is for calls under 1 microsecond, range N is for calls from 2^(N-1) to 2^N microseconds
+  ULONG m_actBuckets[k_ctPluginEventStatsBuckets];
+
+  // Next measured event in the registry
+  PluginEventStats_t *m_pNext;
+
+  // First measured event in the registry of the current module
+  static inline PluginEventStats_t *&Head(void) {
+    static PluginEventStats_t *_pHead = NULL;
+    return _pHead;
+  };
+
+  PluginEventStats_t(const char *strEvent) : m_strEvent(strEvent)
+  {
+    Reset();
+
+    m_pNext = Head();
+    Head() = this;
+  };
+
+  ~PluginEventStats_t()
+  {
+    for (PluginEventStats_t **ppStats = &Head(); *ppStats != NULL; ppStats = &(*ppStats)->m_pNext) {
+      if (*ppStats == this) {
+        *ppStats = m_pNext;
+        break;
+      }
+    }
+  };
+
+  // Discard all measurements
+  void Reset(void)
+  {
+    m_ctCalls = 0;
+    m_llTotal = 0;
+    m_llMin = 0;
+    m_llMax = 0;
+    memset(m_actBuckets, 0, sizeof(m_actBuckets));
+  };
+
+  // Record duration of one call
+  void Add(__int64 llMicroseconds)
+  {
+    if (m_ctCalls == 0 || llMicroseconds < m_llMin) m_llMin = llMicroseconds;
+    if (m_ctCalls == 0 || llMicroseconds > m_llMax) m_llMax = llMicroseconds;
+
+    m_ctCalls++;
+    m_llTotal += llMicroseconds;
+
+    int iBucket = 0;
+    while (iBucket < k_ctPluginEventStatsBuckets - 1 && (llMicroseconds >> iBucket) != 0) iBucket++;
+
+    m_actBuckets[iBucket]++;
+  };
+
+  // Average duration of one call in microseconds
+  inline __int64 GetAverage(void) const {
+    return (m_ctCalls != 0) ? m_llTotal / m_ctCalls : 0;
+  };
+
+  // Upper bound of the duration range that contains a specific percentile of calls (from 0 to 100)
+  __int64 GetPercentile(int iPercentile) const
+  {
+    if (m_ctCalls == 0) return 0;
+
+    const __int64 llThreshold = ((__int64)m_ctCalls * iPercentile + 99) / 100;
+    __int64 llCalls = 0;
+
+    for (int iBucket = 0; iBucket < k_ctPluginEventStatsBuckets; iBucket++) {
+      llCalls += m_actBuckets[iBucket];
+
+      if (llCalls >= llThreshold) {
+        // Never report more than the actual maximum
+        const __int64 llBound = ((__int64)1 << iBucket) - 1;
+        return (llBound < m_llMax) ? llBound : m_llMax;
+      }
+    }
+
+    return m_llMax;
+  };
+
+private:
+  // Measured events are registered by their address and cannot be copied
+  PluginEventStats_t(const PluginEventStats_t &);
+  PluginEventStats_t &operator=(const PluginEventStats_t &);
+};
+
+// Whether event measurements are enabled in the current module
+inline bool &PluginEventStats_Enabled(void) {
+  static bool _bEnabled = false;
+  return _bEnabled;
+};
+
+// Enable or disable event measurements in the current module
+inline void PluginEventStats_SetEnabled(bool bState) {
+  PluginEventStats_Enabled() = bState;
+};
+
+// Get current time in microseconds for measuring durations
+inline __int64 PluginEventStats_GetMicroseconds(void)
+{
+  static __int64 _llFrequency = 0;
+
+  if (_llFrequency == 0) {
+    LARGE_INTEGER liFrequency;
+    QueryPerformanceFrequency(&liFrequency);
+    _llFrequency = liFrequency.QuadPart;
+  }
+
+  LARGE_INTEGER liCounter;
+  QueryPerformanceCounter(&liCounter);
+
+  // Split the conversion to avoid overflowing
+  const __int64 llSeconds = liCounter.QuadPart / _llFrequency;
+  const __int64 llRemainder = liCounter.QuadPart % _llFrequency;
+
+  return llSeconds * 1000000 + (llRemainder * 1000000) / _llFrequency;
+};
+
+// Measures duration of its own lifetime, if event measurements are enabled
+struct PluginEventScope_t
+{
+  PluginEventStats_t *m_pStats; // NULL if not measuring
+  __int64 m_llStart;
+
+  PluginEventScope_t(PluginEventStats_t &stats) : m_pStats(NULL), m_llStart(0)
+  {
+    if (!PluginEventStats_Enabled()) return;
+
+    m_pStats = &stats;
+    m_llStart = PluginEventStats_GetMicroseconds();
+  };
+
+  ~PluginEventScope_t()
+  {
+    if (m_pStats != NULL) m_pStats->Add(PluginEventStats_GetMicroseconds() - m_llStart);
+  };
+};
+
+// Measure the rest of the current function as some event
+#define PLUGINEVENT_MEASURE(event) \
+  static PluginEventStats_t _pluginEventStats(event); \
+  PluginEventScope_t _pluginEventScope(_pluginEventStats)
+
+// Discard measurements of every event in the current module
+inline void PluginEventStats_ResetAll(void)
+{
+  for (PluginEventStats_t *pStats = PluginEventStats_t::Head(); pStats != NULL; pStats = pStats->m_pNext) {
+    pStats->Reset();
+  }
+};
+
+// Write a report about every measured event in the current module into a buffer, one event per line
+// Returns amount of reported events
+inline int PluginEventStats_Report(char *strBuffer, size_t ctBufferSize)
+{
+  int ctEvents = 0;
+  size_t ctUsed = 0;
+  strBuffer[0] = '\0';
+
+  for (PluginEventStats_t *pStats = PluginEventStats_t::Head(); pStats != NULL; pStats = pStats->m_pNext) {
+    char strLine[512];
+
+    sprintf(strLine, "%.256s: %lu calls, min %ld us, avg %ld us, p99 %ld us, max %ld us\n",
+      pStats->m_strEvent, (unsigned long)pStats->m_ctCalls, (long)pStats->m_llMin,
+      (long)pStats->GetAverage(), (long)pStats->GetPercentile(99), (long)pStats->m_llMax);
+
+    if (ctUsed + 1 >= ctBufferSize) break;
+
+    CopyZeroTerminatedString(strBuffer + ctUsed, strLine, ctBufferSize - ctUsed);
+    ctUsed += strlen(strBuffer + ctUsed);
+    ctEvents++;
+  }
+
+  return ctEvents;
+};
+
+// Chat command for viewing event measurements of the current module
+// Arguments: "on" or "off" to toggle measurements, "reset" to discard them, nothing to view them
+inline BOOL PATCH_CALLTYPE PluginEventStats_ChatCommand(ChatCommandResultStr &strResult, INDEX iClient, const char *strArguments)
+{
+  if (strcmp(strArguments, "on") == 0) {
+    PluginEventStats_SetEnabled(true);
+    CopyZeroTerminatedString(strResult, "Event measurements enabled", k_cchMaxChatCommandResultStr);
+
+  } else if (strcmp(strArguments, "off") == 0) {
+    PluginEventStats_SetEnabled(false);
+    CopyZeroTerminatedString(strResult, "Event measurements disabled", k_cchMaxChatCommandResultStr);
+
+  } else if (strcmp(strArguments, "reset") == 0) {
+    PluginEventStats_ResetAll();
+    CopyZeroTerminatedString(strResult, "Event measurements reset", k_cchMaxChatCommandResultStr);
+
+  } else if (PluginEventStats_Report(strResult, k_cchMaxChatCommandResultStr) == 0) {
+    CopyZeroTerminatedString(strResult, "No measured events", k_cchMaxChatCommandResultStr);
+  }
+
+  return TRUE;
+};
+
+// Register a chat command for viewing event measurements of the current module
+// The command is only accessible to server operators
+inline void PluginEventStats_RegisterChatCommand(const char *strCommand)
+{
+  ClassicsChat_RegisterCommandPure(strCommand, &PluginEventStats_ChatCommand);
+  ClassicsChat_SetCommandAccess(strCommand, k_EChatCommandAccessLevel_Operator, TRUE);
+  ClassicsChat_SetCommandInfo(strCommand, "[on|off|reset]", "Measure durations of plugin events");
+};
+
+#endif // CLASSICSPATCH_PLUGINEVENTSTATS_H
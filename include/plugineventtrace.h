@@ -0,0 +1,428 @@
+// Copyright (c) Dreamy Cecil; see copyright notice in LICENSE file
+
+#ifndef CLASSICSPATCH_PLUGINEVENTTRACE_H
+#define CLASSICSPATCH_PLUGINEVENTTRACE_H
+#ifdef _WIN32
+  #pragma once
+#endif
+
+#include "classicspatch_common.h"
+#include "pluginevents.h"
+#include "plugineventstats.h"
+
+//================================================================================================//
+// Plugin event traces
+//
+// Compact binary recordings of plugin events with their timestamps and serialized arguments, which
+// can be replayed outside of the game in order to benchmark and test plugin event functions using
+// real sequences of events.
+//
+// Events are recorded by the plugin itself from within its event functions. Each record consists of
+// an 8-byte header and optional data, such as indices and strings from event arguments. Arguments
+// that are engine objects cannot be serialized as a whole and need to be recorded in a custom way.
+//
+// Events are replayed by a standalone program that reads a trace and calls event functions in the
+// same order, either as fast as possible or with the same delays between them as during recording.
+// Only events without arguments are called directly. Arguments of most events are engine objects
+// that cannot be rebuilt from a trace, so the rest of the events are only passed into a custom
+// function, which needs to make do with whatever has been recorded for them.
+//
+// Example usage:
+//    // Recording in the plugin
+//    void PATCH_CALLTYPE IProcessingEvents_OnStep(void) {
+//      PluginEventTrace().RecordEvent(k_EPluginTraceEvent_OnStep);
+//      ...
+//    };
+//
+//    void PATCH_CALLTYPE IPacketEvents_OnPlayerAction(INDEX iClient, INDEX iPlayer, CPlayerAction &pa, INDEX iResent) {
+//      PluginEventTrace().RecordPlayerAction(iClient, iPlayer, pa, iResent);
+//      ...
+//    };
+//
+//    // Replaying in a program that's linked with plugin sources
+//    PluginEventTraceReplay_t replay;
+//    replay.m_processing.OnStep = &IProcessingEvents_OnStep;
+//    replay.m_pHandler = &ReplayPlayerAction;
+//    replay.Replay("Trace.bin");
+//================================================================================================//
+
+// Recorded plugin events
+enum EPluginTraceEvent
+{
+  // IProcessingEvents
+  k_EPluginTraceEvent_OnStep = 0,
+  k_EPluginTraceEvent_OnFrame,
+
+  // IRenderingEvents
+  k_EPluginTraceEvent_OnPreDraw,
+  k_EPluginTraceEvent_OnPostDraw,
+  k_EPluginTraceEvent_OnRenderView,
+
+  // INetworkEvents
+  k_EPluginTraceEvent_OnServerPacket, // PluginTracePacket_t + message data
+  k_EPluginTraceEvent_OnClientPacket, // PluginTracePacket_t + message data
+  k_EPluginTraceEvent_OnAddPlayer,
+  k_EPluginTraceEvent_OnRemovePlayer,
+
+  // IPacketEvents
+  k_EPluginTraceEvent_OnCharacterConnect,
+  k_EPluginTraceEvent_OnCharacterChange,
+  k_EPluginTraceEvent_OnPlayerAction, // PluginTracePlayerAction_t + action data
+  k_EPluginTraceEvent_OnChatMessage, // PluginTraceChatMessage_t + message string
+
+  // IGameEvents
+  k_EPluginTraceEvent_OnGameStart,
+  k_EPluginTraceEvent_OnChangeLevel,
+  k_EPluginTraceEvent_OnGameStop,
+  k_EPluginTraceEvent_OnGameSave, // File name string
+  k_EPluginTraceEvent_OnGameLoad, // File name string
+
+  // IDemoEvents
+  k_EPluginTraceEvent_OnDemoPlay, // File name string
+  k_EPluginTraceEvent_OnDemoStart, // File name string
+  k_EPluginTraceEvent_OnDemoStop,
+
+  // IWorldEvents
+  k_EPluginTraceEvent_OnWorldLoad, // File name string
+
+  // IListenerEvents
+  k_EPluginTraceEvent_OnSendEvent,
+  k_EPluginTraceEvent_OnReceiveItem,
+  k_EPluginTraceEvent_OnCallProcedure,
+
+  // ITimerEvents
+  k_EPluginTraceEvent_OnTick,
+  k_EPluginTraceEvent_OnSecond,
+
+  k_EPluginTraceEvent_Max,
+};
+
+// Trace format identifiers
+const ULONG k_ulPluginTraceMagic = 0x52544550; // "PETR"
+const ULONG k_ulPluginTraceVersion = 1;
+
+// Maximum size of record data
+const size_t k_ctMaxPluginTraceData = 0xFFFF;
+
+// Header of each record, which is followed by its data
+struct PluginTraceRecord_t {
+  UBYTE m_eEvent; // EPluginTraceEvent
+  UBYTE m_ubReserved;
+  UWORD m_ctDataSize;
+  ULONG m_ulTimeDelta; // Microseconds since the previous record
+};
+
+// Data of packet events
+struct PluginTracePacket_t {
+  ULONG m_ulType;
+};
+
+// Data of player action events
+struct PluginTracePlayerAction_t {
+  INDEX m_iClient;
+  INDEX m_iPlayer;
+  INDEX m_iResent;
+};
+
+// Data of chat message events
+struct PluginTraceChatMessage_t {
+  INDEX m_iClient;
+  ULONG m_ulFrom;
+  ULONG m_ulTo;
+};
+
+// Writes events into a trace file
+class PluginEventTraceRecorder_t
+{
+public:
+  FILE *m_file; // NULL if not recording
+  __int64 m_llLastTime;
+
+  // Records are accumulated here before being written into the file (fits the biggest possible record)
+  UBYTE m_aubBuffer[0x20000];
+  size_t m_ctBuffered;
+
+public:
+  PluginEventTraceRecorder_t() : m_file(NULL), m_llLastTime(0), m_ctBuffered(0) {};
+
+  ~PluginEventTraceRecorder_t() {
+    Stop();
+  };
+
+  // Check whether events are being recorded
+  inline bool IsRecording(void) const {
+    return (m_file != NULL);
+  };
+
+  // Start recording events into a file
+  bool Start(const char *strFile)
+  {
+    Stop();
+
+    m_file = fopen(strFile, "wb");
+    if (m_file == NULL) return false;
+
+    const ULONG aulHeader[2] = { k_ulPluginTraceMagic, k_ulPluginTraceVersion };
+    fwrite(aulHeader, sizeof(aulHeader), 1, m_file);
+
+    m_llLastTime = PluginEventStats_GetMicroseconds();
+    return true;
+  };
+
+  // Finish writing the file
+  void Stop(void)
+  {
+    if (m_file == NULL) return;
+
+    Flush();
+    fclose(m_file);
+    m_file = NULL;
+  };
+
+  // Write buffered records into the file
+  void Flush(void)
+  {
+    if (m_ctBuffered == 0) return;
+
+    fwrite(m_aubBuffer, m_ctBuffered, 1, m_file);
+    m_ctBuffered = 0;
+  };
+
+  // Record an event with two data blocks, which are written one after another
+  void Record(EPluginTraceEvent eEvent, const void *pData1, size_t ctSize1, const void *pData2 = NULL, size_t ctSize2 = 0)
+  {
+    if (m_file == NULL) return;
+
+    // Cut excessive data
+    if (ctSize1 > k_ctMaxPluginTraceData) ctSize1 = k_ctMaxPluginTraceData;
+    if (ctSize2 > k_ctMaxPluginTraceData - ctSize1) ctSize2 = k_ctMaxPluginTraceData - ctSize1;
+
+    const size_t ctRecord = sizeof(PluginTraceRecord_t) + ctSize1 + ctSize2;
+    if (m_ctBuffered + ctRecord > sizeof(m_aubBuffer)) Flush();
+
+    const __int64 llTime = PluginEventStats_GetMicroseconds();
+
+    PluginTraceRecord_t rec;
+    rec.m_eEvent = (UBYTE)eEvent;
+    rec.m_ubReserved = 0;
+    rec.m_ctDataSize = (UWORD)(ctSize1 + ctSize2);
+    rec.m_ulTimeDelta = (ULONG)(llTime - m_llLastTime);
+    m_llLastTime = llTime;
+
+    UBYTE *pubRecord = m_aubBuffer + m_ctBuffered;
+    memcpy(pubRecord, &rec, sizeof(rec));
+    if (ctSize1 != 0) memcpy(pubRecord + sizeof(rec), pData1, ctSize1);
+    if (ctSize2 != 0) memcpy(pubRecord + sizeof(rec) + ctSize1, pData2, ctSize2);
+
+    m_ctBuffered += ctRecord;
+  };
+
+  // Record an event without data
+  inline void RecordEvent(EPluginTraceEvent eEvent) {
+    Record(eEvent, NULL, 0);
+  };
+
+  // Record an event with a string, e.g. a file name
+  inline void RecordString(EPluginTraceEvent eEvent, const char *str) {
+    if (m_file != NULL) Record(eEvent, str, strlen(str));
+  };
+
+  // Record an extension packet event with raw message data
+  inline void RecordPacket(EPluginTraceEvent eEvent, ULONG ulType, const void *pMessage, size_t ctMessageSize)
+  {
+    PluginTracePacket_t data;
+    data.m_ulType = ulType;
+    Record(eEvent, &data, sizeof(data), pMessage, ctMessageSize);
+  };
+
+  // Record a player action event with a copy of the action
+  template<class ActionType> inline
+  void RecordPlayerAction(INDEX iClient, INDEX iPlayer, const ActionType &pa, INDEX iResent)
+  {
+    PluginTracePlayerAction_t data;
+    data.m_iClient = iClient;
+    data.m_iPlayer = iPlayer;
+    data.m_iResent = iResent;
+    Record(k_EPluginTraceEvent_OnPlayerAction, &data, sizeof(data), &pa, sizeof(pa));
+  };
+
+  // Record a chat message event
+  inline void RecordChatMessage(INDEX iClient, ULONG ulFrom, ULONG ulTo, const char *strMessage)
+  {
+    if (m_file == NULL) return;
+
+    PluginTraceChatMessage_t data;
+    data.m_iClient = iClient;
+    data.m_ulFrom = ulFrom;
+    data.m_ulTo = ulTo;
+    Record(k_EPluginTraceEvent_OnChatMessage, &data, sizeof(data), strMessage, strlen(strMessage));
+  };
+
+private:
+  // Recorders own their files and cannot be copied
+  PluginEventTraceRecorder_t(const PluginEventTraceRecorder_t &);
+  PluginEventTraceRecorder_t &operator=(const PluginEventTraceRecorder_t &);
+};
+
+// Event trace recorder of the current module
+inline PluginEventTraceRecorder_t &PluginEventTrace(void) {
+  static PluginEventTraceRecorder_t _recorder;
+  return _recorder;
+};
+
+// Reads events from a trace file
+class PluginEventTraceReader_t
+{
+public:
+  FILE *m_file;
+  __int64 m_llTime; // Microseconds since the beginning of the trace
+
+  // Data of the last read record
+  PluginTraceRecord_t m_rec;
+  UBYTE m_aubData[k_ctMaxPluginTraceData + 1];
+
+public:
+  PluginEventTraceReader_t() : m_file(NULL), m_llTime(0) {};
+
+  ~PluginEventTraceReader_t() {
+    Close();
+  };
+
+  // Open a trace file
+  bool Open(const char *strFile)
+  {
+    Close();
+
+    m_file = fopen(strFile, "rb");
+    if (m_file == NULL) return false;
+
+    ULONG aulHeader[2];
+
+    if (fread(aulHeader, sizeof(aulHeader), 1, m_file) != 1
+     || aulHeader[0] != k_ulPluginTraceMagic || aulHeader[1] != k_ulPluginTraceVersion) {
+      Close();
+      return false;
+    }
+
+    m_llTime = 0;
+    return true;
+  };
+
+  // Close the trace file
+  void Close(void)
+  {
+    if (m_file == NULL) return;
+
+    fclose(m_file);
+    m_file = NULL;
+  };
+
+  // Read the next record into m_rec and its data into m_aubData
+  // Data is always followed by a null terminator, so that strings can be read directly
+  // Returns false when there are no more records
+  bool Next(void)
+  {
+    if (m_file == NULL) return false;
+    if (fread(&m_rec, sizeof(m_rec), 1, m_file) != 1) return false;
+
+    if (m_rec.m_ctDataSize != 0 && fread(m_aubData, m_rec.m_ctDataSize, 1, m_file) != 1) return false;
+
+    m_aubData[m_rec.m_ctDataSize] = '\0';
+    m_llTime += m_rec.m_ulTimeDelta;
+    return true;
+  };
+
+private:
+  // Readers own their files and cannot be copied
+  PluginEventTraceReader_t(const PluginEventTraceReader_t &);
+  PluginEventTraceReader_t &operator=(const PluginEventTraceReader_t &);
+};
+
+// Function for replaying events that cannot be called directly
+// Returns false to stop replaying
+typedef bool (*FPluginTraceHandler)(const PluginEventTraceReader_t &reader, void *pUserData);
+
+// Calls event functions from a trace
+struct PluginEventTraceReplay_t
+{
+  // Functions of events without arguments
+  IProcessingEvents m_processing; // Only OnStep
+  IGameEvents m_game; // Only OnGameStart, OnChangeLevel and OnGameStop
+  IDemoEvents m_demo; // Only OnDemoStop
+  ITimerEvents m_timer;
+
+  // Function for all other events
+  FPluginTraceHandler m_pHandler;
+  void *m_pUserData;
+
+  PluginEventTraceReplay_t() : m_pHandler(NULL), m_pUserData(NULL)
+  {
+    memset(&m_processing, 0, sizeof(m_processing));
+    memset(&m_game, 0, sizeof(m_game));
+    memset(&m_demo, 0, sizeof(m_demo));
+    memset(&m_timer, 0, sizeof(m_timer));
+  };
+
+  // Call functions of the last read event
+  // Returns false to stop replaying
+  bool Dispatch(const PluginEventTraceReader_t &reader)
+  {
+    #define PLUGINTRACE_CALL(_Interface, _Function) \
+      case k_EPluginTraceEvent_##_Function: if (_Interface._Function != NULL) _Interface._Function(); return true;
+
+    switch (reader.m_rec.m_eEvent) {
+      PLUGINTRACE_CALL(m_processing, OnStep);
+      PLUGINTRACE_CALL(m_game, OnGameStart);
+      PLUGINTRACE_CALL(m_game, OnChangeLevel);
+      PLUGINTRACE_CALL(m_game, OnGameStop);
+      PLUGINTRACE_CALL(m_demo, OnDemoStop);
+      PLUGINTRACE_CALL(m_timer, OnTick);
+      PLUGINTRACE_CALL(m_timer, OnSecond);
+    }
+
+    #undef PLUGINTRACE_CALL
+
+    if (m_pHandler == NULL) return true;
+    return m_pHandler(reader, m_pUserData);
+  };
+
+  // Replay all events from a trace file as fast as possible or with recorded delays between them
+  // Returns amount of replayed events or -1 if the file cannot be opened
+  int Replay(const char *strFile, bool bRealTime = false)
+  {
+    PluginEventTraceReader_t *pReader = new PluginEventTraceReader_t;
+
+    if (!pReader->Open(strFile)) {
+      delete pReader;
+      return -1;
+    }
+
+    int ctEvents = 0;
+    const __int64 llStart = PluginEventStats_GetMicroseconds();
+
+    while (pReader->Next()) {
+      // Timestamps are relative to the start of recording, so delays after slow event functions are shortened
+      if (bRealTime) WaitUntil(llStart + pReader->m_llTime);
+
+      ctEvents++;
+      if (!Dispatch(*pReader)) break;
+    }
+
+    delete pReader;
+    return ctEvents;
+  };
+
+private:
+  // Sleep through most of the time until some moment and yield through the rest for precision
+  static void WaitUntil(__int64 llTime)
+  {
+    for (;;) {
+      const __int64 llLeft = llTime - PluginEventStats_GetMicroseconds();
+      if (llLeft <= 0) return;
+
+      Sleep(llLeft > 2000 ? DWORD(llLeft / 1000) - 1 : 0);
+    }
+  };
+};
+
+#endif // CLASSICSPATCH_PLUGINEVENTTRACE_H
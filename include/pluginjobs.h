@@ -0,0 +1,381 @@
+// Copyright (c) Dreamy Cecil; see copyright notice in LICENSE file
+
+#ifndef CLASSICSPATCH_PLUGINJOBS_H
+#define CLASSICSPATCH_PLUGINJOBS_H
+#ifdef _WIN32
+  #pragma once
+#endif
+
+#include "classicspatch_common.h"
+
+#include <process.h>
+
+//================================================================================================//
+// Plugin jobs
+//
+// Pool of worker threads for offloading work from the simulation thread, such as gathering stats,
+// writing files or precomputing paths, which would otherwise be performed during plugin events.
+//
+// Each worker thread has its own queue of jobs. Submitted jobs are distributed between queues and
+// workers that run out of jobs in their own queues steal them from other queues.
+//
+// Every plugin that uses jobs has its own pool, so the amount of worker threads per pool is capped at
+// PluginJobs_t::k_ctMaxWorkers in order to not multiply threads by the amount of loaded plugins.
+// If no worker threads can be started, submitted jobs are executed immediately on the calling thread.
+//
+// Jobs may have completion functions that are executed on the thread that owns the pool, in order
+// to safely pass results back into the game. They are only executed upon calling RunCompletions(),
+// which should be done at a specific point during the tick, e.g. in IProcessingEvents::OnStep.
+//
+// IMPORTANT: Job functions run on worker threads and must not interact with the engine or the API!
+//
+// The pool needs to be stopped during plugin shutdown. Static pools are destroyed while the library
+// is being unloaded, when waiting for threads would deadlock, so the destructor of a running pool only
+// tells its workers to stop and leaks everything they might still be using.
+//
+// Example usage:
+//    static PluginJobs_t _jobs;
+//
+//    void PATCH_CALLTYPE IProcessingEvents_OnStep(void) {
+//      _jobs.RunCompletions(); // Executes OnStatsWritten() after WriteStats() is done
+//      ...
+//      _jobs.Submit(&WriteStats, &OnStatsWritten, pStats);
+//    };
+//
+//    CLASSICSPATCH_PLUGIN_STARTUP(HIniConfig props, PluginEvents_t &events) {
+//      _jobs.Start();
+//      events.m_processing->OnStep = &IProcessingEvents_OnStep;
+//    };
+//
+//    CLASSICSPATCH_PLUGIN_SHUTDOWN(HIniConfig props) {
+//      _jobs.Stop();
+//    };
+//================================================================================================//
+
+// Function that performs a job on a worker thread
+typedef void (PATCH_CALLTYPE *FPluginJob)(void *pUserData);
+
+// Function that's executed after the job is done on the thread that owns the pool
+typedef void (PATCH_CALLTYPE *FPluginJobDone)(void *pUserData);
+
+// One submitted job
+struct PluginJob_t {
+  FPluginJob m_pJob;
+  FPluginJobDone m_pDone; // May be NULL
+  void *m_pUserData;
+
+  PluginJob_t *m_pPrev;
+  PluginJob_t *m_pNext;
+};
+
+// Pool of worker threads
+class PluginJobs_t
+{
+public:
+  // Maximum amount of worker threads per pool
+  enum { k_ctMaxWorkers = 4 };
+
+  // Worker thread with its own queue of jobs
+  struct Worker_t {
+    PluginJobs_t *m_pPool;
+    HANDLE m_hThread;
+
+    // Owner takes jobs from the back and other workers steal them from the front
+    CRITICAL_SECTION m_csQueue;
+    PluginJob_t *m_pFront;
+    PluginJob_t *m_pBack;
+  };
+
+  Worker_t m_aWorkers[k_ctMaxWorkers];
+  int m_ctWorkers;
+
+  // Counts submitted jobs that haven't been taken yet
+  HANDLE m_hJobsSemaphore;
+
+  // Next worker queue for submitting jobs into
+  volatile LONG m_iNextWorker;
+  volatile LONG m_bStopping;
+
+  // Finished jobs with completion functions
+  CRITICAL_SECTION m_csDone;
+  PluginJob_t *m_pDoneFirst;
+  PluginJob_t *m_pDoneLast;
+
+public:
+  PluginJobs_t() : m_ctWorkers(0), m_hJobsSemaphore(NULL), m_iNextWorker(0), m_bStopping(FALSE),
+    m_pDoneFirst(NULL), m_pDoneLast(NULL)
+  {
+    InitializeCriticalSection(&m_csDone);
+  };
+
+  ~PluginJobs_t() {
+    // Never wait for workers here, since it may be happening under the loader lock
+    if (IsRunning()) {
+      InterlockedExchange(&m_bStopping, TRUE);
+      ReleaseSemaphore(m_hJobsSemaphore, m_ctWorkers, NULL);
+      return;
+    }
+
+    DeleteCriticalSection(&m_csDone);
+  };
+
+  // Check whether the worker threads are running
+  inline bool IsRunning(void) const {
+    return (m_ctWorkers != 0);
+  };
+
+  // Start worker threads
+  // If the amount of threads isn't specified, it's one less than the amount of logical processors
+  // The amount is capped at k_ctMaxWorkers and may be lower if some threads cannot be created
+  void Start(int ctThreads = 0)
+  {
+    if (IsRunning()) return;
+
+    if (ctThreads <= 0) {
+      SYSTEM_INFO si;
+      GetSystemInfo(&si);
+      ctThreads = (int)si.dwNumberOfProcessors - 1;
+    }
+
+    if (ctThreads < 1) ctThreads = 1;
+    if (ctThreads > k_ctMaxWorkers) ctThreads = k_ctMaxWorkers;
+
+    m_hJobsSemaphore = CreateSemaphoreA(NULL, 0, 0x7FFFFFFF, NULL);
+    if (m_hJobsSemaphore == NULL) return;
+
+    m_bStopping = FALSE;
+
+    for (int iWorker = 0; iWorker < ctThreads; iWorker++) {
+      Worker_t &worker = m_aWorkers[iWorker];
+      worker.m_pPool = this;
+      worker.m_pFront = NULL;
+      worker.m_pBack = NULL;
+      InitializeCriticalSection(&worker.m_csQueue);
+    }
+
+    // Start threads only after all queues are ready for stealing
+    m_ctWorkers = ctThreads;
+
+    int ctStarted = 0;
+
+    for (; ctStarted < ctThreads; ctStarted++) {
+      // Jobs may use the CRT, so threads are started through it
+      const uintptr_t iThread = _beginthreadex(NULL, 0, &WorkerThread, &m_aWorkers[ctStarted], 0, NULL);
+      if (iThread == 0) break;
+
+      m_aWorkers[ctStarted].m_hThread = (HANDLE)iThread;
+    }
+
+    // Forget queues without threads, which is safe because workers don't look at other queues until
+    // any job is submitted
+    for (int iUnused = ctStarted; iUnused < ctThreads; iUnused++) {
+      DeleteCriticalSection(&m_aWorkers[iUnused].m_csQueue);
+    }
+
+    m_ctWorkers = ctStarted;
+
+    // Execute jobs immediately without any threads
+    if (ctStarted == 0) {
+      CloseHandle(m_hJobsSemaphore);
+      m_hJobsSemaphore = NULL;
+    }
+  };
+
+  // Finish all submitted jobs, stop worker threads and execute remaining completion functions
+  void Stop(void)
+  {
+    if (!IsRunning()) return;
+
+    // Wake up every worker to let it know that it should stop after running out of jobs
+    InterlockedExchange(&m_bStopping, TRUE);
+    ReleaseSemaphore(m_hJobsSemaphore, m_ctWorkers, NULL);
+
+    int iWorker;
+
+    for (iWorker = 0; iWorker < m_ctWorkers; iWorker++) {
+      WaitForSingleObject(m_aWorkers[iWorker].m_hThread, INFINITE);
+      CloseHandle(m_aWorkers[iWorker].m_hThread);
+    }
+
+    // Queues can only be destroyed after no one can steal from them
+    for (iWorker = 0; iWorker < m_ctWorkers; iWorker++) {
+      DeleteCriticalSection(&m_aWorkers[iWorker].m_csQueue);
+    }
+
+    m_ctWorkers = 0;
+    CloseHandle(m_hJobsSemaphore);
+    m_hJobsSemaphore = NULL;
+
+    RunCompletions();
+  };
+
+  // Submit a new job
+  // If the pool isn't running, the job and its completion function are executed immediately
+  void Submit(FPluginJob pJob, FPluginJobDone pDone, void *pUserData)
+  {
+    if (!IsRunning()) {
+      pJob(pUserData);
+      if (pDone != NULL) pDone(pUserData);
+      return;
+    }
+
+    PluginJob_t *pNew = new PluginJob_t;
+    pNew->m_pJob = pJob;
+    pNew->m_pDone = pDone;
+    pNew->m_pUserData = pUserData;
+    pNew->m_pPrev = NULL;
+    pNew->m_pNext = NULL;
+
+    // Distribute jobs between workers
+    const LONG iWorker = InterlockedIncrement(&m_iNextWorker);
+    Worker_t &worker = m_aWorkers[(ULONG)iWorker % (ULONG)m_ctWorkers];
+
+    EnterCriticalSection(&worker.m_csQueue);
+    {
+      pNew->m_pPrev = worker.m_pBack;
+
+      if (worker.m_pBack != NULL) {
+        worker.m_pBack->m_pNext = pNew;
+      } else {
+        worker.m_pFront = pNew;
+      }
+
+      worker.m_pBack = pNew;
+    }
+    LeaveCriticalSection(&worker.m_csQueue);
+
+    ReleaseSemaphore(m_hJobsSemaphore, 1, NULL);
+  };
+
+  // Execute completion functions of finished jobs on the current thread
+  // Returns amount of executed functions
+  int RunCompletions(void)
+  {
+    EnterCriticalSection(&m_csDone);
+    PluginJob_t *pJob = m_pDoneFirst;
+    m_pDoneFirst = NULL;
+    m_pDoneLast = NULL;
+    LeaveCriticalSection(&m_csDone);
+
+    int ctExecuted = 0;
+
+    while (pJob != NULL) {
+      PluginJob_t *pNext = pJob->m_pNext;
+
+      pJob->m_pDone(pJob->m_pUserData);
+      delete pJob;
+
+      pJob = pNext;
+      ctExecuted++;
+    }
+
+    return ctExecuted;
+  };
+
+private:
+  // Take the newest job from own queue
+  static PluginJob_t *PopBack(Worker_t &worker)
+  {
+    EnterCriticalSection(&worker.m_csQueue);
+    PluginJob_t *pJob = worker.m_pBack;
+
+    if (pJob != NULL) {
+      worker.m_pBack = pJob->m_pPrev;
+
+      if (worker.m_pBack != NULL) {
+        worker.m_pBack->m_pNext = NULL;
+      } else {
+        worker.m_pFront = NULL;
+      }
+    }
+
+    LeaveCriticalSection(&worker.m_csQueue);
+    return pJob;
+  };
+
+  // Steal the oldest job from another queue
+  static PluginJob_t *PopFront(Worker_t &worker)
+  {
+    EnterCriticalSection(&worker.m_csQueue);
+    PluginJob_t *pJob = worker.m_pFront;
+
+    if (pJob != NULL) {
+      worker.m_pFront = pJob->m_pNext;
+
+      if (worker.m_pFront != NULL) {
+        worker.m_pFront->m_pPrev = NULL;
+      } else {
+        worker.m_pBack = NULL;
+      }
+    }
+
+    LeaveCriticalSection(&worker.m_csQueue);
+    return pJob;
+  };
+
+  // Find any job for a worker, starting with its own queue
+  PluginJob_t *FindJob(int iWorker)
+  {
+    PluginJob_t *pJob = PopBack(m_aWorkers[iWorker]);
+
+    for (int iOther = 1; pJob == NULL && iOther < m_ctWorkers; iOther++) {
+      pJob = PopFront(m_aWorkers[(iWorker + iOther) % m_ctWorkers]);
+    }
+
+    return pJob;
+  };
+
+  // Queue a finished job for executing its completion function
+  void FinishJob(PluginJob_t *pJob)
+  {
+    if (pJob->m_pDone == NULL) {
+      delete pJob;
+      return;
+    }
+
+    pJob->m_pNext = NULL;
+
+    EnterCriticalSection(&m_csDone);
+
+    if (m_pDoneLast != NULL) {
+      m_pDoneLast->m_pNext = pJob;
+    } else {
+      m_pDoneFirst = pJob;
+    }
+
+    m_pDoneLast = pJob;
+    LeaveCriticalSection(&m_csDone);
+  };
+
+  static unsigned __stdcall WorkerThread(void *pParam)
+  {
+    Worker_t &worker = *(Worker_t *)pParam;
+    PluginJobs_t &pool = *worker.m_pPool;
+    const int iWorker = int(&worker - pool.m_aWorkers);
+
+    for (;;) {
+      WaitForSingleObject(pool.m_hJobsSemaphore, INFINITE);
+
+      // Each semaphore count matches one queued job, unless the pool is being stopped
+      PluginJob_t *pJob = pool.FindJob(iWorker);
+
+      if (pJob == NULL) {
+        if (pool.m_bStopping) return 0;
+
+        // Another worker took this job while it was being searched for and left its own one in a
+        // queue that has already been searched, so give the count back and wait for it again
+        ReleaseSemaphore(pool.m_hJobsSemaphore, 1, NULL);
+        continue;
+      }
+
+      pJob->m_pJob(pJob->m_pUserData);
+      pool.FinishJob(pJob);
+    }
+  };
+
+  // Pools own their threads and cannot be copied
+  PluginJobs_t(const PluginJobs_t &);
+  PluginJobs_t &operator=(const PluginJobs_t &);
+};
+
+#endif // CLASSICSPATCH_PLUGINJOBS_H
@@ -0,0 +1,430 @@
+// Copyright (c) Dreamy Cecil; see copyright notice in LICENSE file
+
+#ifndef CLASSICSPATCH_PLUGINPACKETSTATS_H
+#define CLASSICSPATCH_PLUGINPACKETSTATS_H
+#ifdef _WIN32
+  #pragma once
+#endif
+
+#include "classicspatch_common.h"
+#include "extpackets.h"
+#include "ichat.h"
+#include "plugineventstats.h"
+#include "plugintimers.h"
+
+//================================================================================================//
+// Plugin packet statistics
+//
+// Traffic counters for finding out which extension packets take up most of the bandwidth. Packets
+// and bytes that have been sent and received, as well as time spent reading and processing received
+// packets, are counted per packet type and per client index. Packets that are passed into routers are
+// read and processed by the same handler, so only the total time of both steps is counted for them.
+//
+// Counters are only updated using interlocked operations, so packets can be counted from any thread.
+// They are 32-bit and wrap around after ~4 GB per byte counter or ~35 minutes per time counter, which
+// are signed sums of microseconds, so they should be reset every once in a while, e.g. after each
+// periodic dump.
+//
+// Packets that are sent to all clients at once are only counted per packet type, because the meter
+// doesn't know who has received them. Per-client sent counters are only filled by meters that are
+// created with a specific client index.
+//
+// Classics Patch sends and receives packets internally, so only packets that go through the
+// functions below are counted.
+//
+// Meters and received packet functions access internal fields of network messages, so Serious
+// Engine headers are required.
+//
+// Example usage:
+//    // Count sent packet
+//    PluginPacketMeter_t<>(&pck).SendToClients();
+//
+//    BOOL PATCH_CALLTYPE INetworkEvents_OnClientPacket(CNetworkMessage &nmMessage, const ULONG ulType) {
+//      return PluginPacketStats_Dispatch(nmMessage, ulType, -1, _routerClient);
+//    };
+//
+//    static void PATCH_CALLTYPE PrintStats(const char *strReport, void *pUserData) {
+//      CPrintF("%s", strReport);
+//    };
+//
+//    CLASSICSPATCH_PLUGIN_STARTUP(HIniConfig props, PluginEvents_t &events) {
+//      // Print traffic every minute
+//      PluginPacketStats().StartDump(60 * 20, &PrintStats);
+//      PluginPacketStats_RegisterChatCommand("myplugin_traffic");
+//    };
+//================================================================================================//
+
+// Maximum amount of distinct counted packet types
+const int k_ctPluginPacketStatsTypes = 256;
+
+// Maximum amount of counted client indices
+const int k_ctPluginPacketStatsClients = 32;
+
+// Size of the buffer for periodic dumps
+const size_t k_ctPluginPacketStatsDumpSize = 0x4000;
+
+// Function that outputs a periodic traffic report
+typedef void (PATCH_CALLTYPE *FPluginPacketStatsOutput)(const char *strReport, void *pUserData);
+
+// Traffic counters of one packet type or one client
+struct PluginPacketTraffic_t
+{
+  volatile LONG m_ctSent;
+  volatile LONG m_ctBytesSent;
+  volatile LONG m_ctReceived;
+  volatile LONG m_ctBytesReceived;
+  volatile LONG m_ctReadTime; // Microseconds spent reading received packets
+  volatile LONG m_ctProcessTime; // Microseconds spent processing received packets
+  volatile LONG m_ctRoutedTime; // Microseconds spent reading and processing received packets in routers
+
+  // Reset all counters
+  void Reset(void)
+  {
+    InterlockedExchange(&m_ctSent, 0);
+    InterlockedExchange(&m_ctBytesSent, 0);
+    InterlockedExchange(&m_ctReceived, 0);
+    InterlockedExchange(&m_ctBytesReceived, 0);
+    InterlockedExchange(&m_ctReadTime, 0);
+    InterlockedExchange(&m_ctProcessTime, 0);
+    InterlockedExchange(&m_ctRoutedTime, 0);
+  };
+
+  // Count one sent packet
+  inline void AddSent(SLONG slBytes)
+  {
+    InterlockedIncrement(&m_ctSent);
+    InterlockedExchangeAdd(&m_ctBytesSent, slBytes);
+  };
+
+  // Count one received packet
+  // If the read time is negative, the process time includes reading and is counted as routed time
+  inline void AddReceived(SLONG slBytes, __int64 llReadTime, __int64 llProcessTime)
+  {
+    InterlockedIncrement(&m_ctReceived);
+    InterlockedExchangeAdd(&m_ctBytesReceived, slBytes);
+
+    if (llReadTime < 0) {
+      InterlockedExchangeAdd(&m_ctRoutedTime, (LONG)llProcessTime);
+      return;
+    }
+
+    InterlockedExchangeAdd(&m_ctReadTime, (LONG)llReadTime);
+    InterlockedExchangeAdd(&m_ctProcessTime, (LONG)llProcessTime);
+  };
+
+  // Total amount of sent and received bytes
+  inline ULONG GetTotalBytes(void) const {
+    return (ULONG)m_ctBytesSent + (ULONG)m_ctBytesReceived;
+  };
+};
+
+// Traffic counters of the current module
+class PluginPacketStats_t
+{
+public:
+  // Counters of one packet type
+  struct Type_t {
+    volatile LONG m_lType; // -1 if unused
+    PluginPacketTraffic_t m_traffic;
+  };
+
+  // Packet types in an open addressing table that's never rehashed
+  Type_t m_aTypes[k_ctPluginPacketStatsTypes];
+
+  PluginPacketTraffic_t m_aClients[k_ctPluginPacketStatsClients];
+
+  // Periodic dump
+  PluginTimer_t m_tmrDump;
+  FPluginPacketStatsOutput m_pOutput;
+  void *m_pOutputData;
+  bool m_bResetAfterDump;
+
+public:
+  PluginPacketStats_t() : m_tmrDump(&DumpTimer, this), m_pOutput(NULL), m_pOutputData(NULL), m_bResetAfterDump(true)
+  {
+    for (int iType = 0; iType < k_ctPluginPacketStatsTypes; iType++) {
+      m_aTypes[iType].m_lType = -1;
+    }
+
+    Reset();
+  };
+
+  // Reset all counters while keeping counted packet types
+  void Reset(void)
+  {
+    for (int iType = 0; iType < k_ctPluginPacketStatsTypes; iType++) {
+      m_aTypes[iType].m_traffic.Reset();
+    }
+
+    for (int iClient = 0; iClient < k_ctPluginPacketStatsClients; iClient++) {
+      m_aClients[iClient].Reset();
+    }
+  };
+
+  // Get counters of a specific packet type
+  // Returns NULL if the type hasn't been counted yet and bAdd is false or if there are too many types
+  // Type 0xFFFFFFFF is reserved for unused slots and is never counted
+  PluginPacketTraffic_t *ForType(ULONG ulType, bool bAdd = false)
+  {
+    const LONG lType = (LONG)ulType;
+    if (lType == -1) return NULL;
+
+    ULONG iSlot = (ulType * 2654435761UL) & (k_ctPluginPacketStatsTypes - 1);
+
+    for (int iProbe = 0; iProbe < k_ctPluginPacketStatsTypes; iProbe++) {
+      Type_t &type = m_aTypes[iSlot];
+      LONG lSlotType = type.m_lType;
+
+      // Claim an unused slot, unless another thread has just claimed it for some type
+      if (lSlotType == -1) {
+        if (!bAdd) return NULL;
+
+        lSlotType = InterlockedCompareExchange(&type.m_lType, lType, -1);
+        if (lSlotType == -1) return &type.m_traffic;
+      }
+
+      if (lSlotType == lType) return &type.m_traffic;
+
+      iSlot = (iSlot + 1) & (k_ctPluginPacketStatsTypes - 1);
+    }
+
+    return NULL;
+  };
+
+  // Get counters of a specific client
+  // Returns NULL if the client index is out of range
+  inline PluginPacketTraffic_t *ForClient(INDEX iClient)
+  {
+    if (iClient < 0 || iClient >= k_ctPluginPacketStatsClients) return NULL;
+    return &m_aClients[iClient];
+  };
+
+  // Count packet that's been sent to a specific client or to all clients/server, if the index is -1
+  void CountSent(ULONG ulType, INDEX iClient, SLONG slBytes)
+  {
+    PluginPacketTraffic_t *pType = ForType(ulType, true);
+    if (pType != NULL) pType->AddSent(slBytes);
+
+    PluginPacketTraffic_t *pClient = ForClient(iClient);
+    if (pClient != NULL) pClient->AddSent(slBytes);
+  };
+
+  // Count packet that's been received from a specific client or from the server, if the index is -1
+  // Negative read time means that it hasn't been measured separately from the process time
+  void CountReceived(ULONG ulType, INDEX iClient, SLONG slBytes, __int64 llReadTime, __int64 llProcessTime)
+  {
+    PluginPacketTraffic_t *pType = ForType(ulType, true);
+    if (pType != NULL) pType->AddReceived(slBytes, llReadTime, llProcessTime);
+
+    PluginPacketTraffic_t *pClient = ForClient(iClient);
+    if (pClient != NULL) pClient->AddReceived(slBytes, llReadTime, llProcessTime);
+  };
+
+  // Write a report into a buffer with one packet type per line, starting from the most bytes,
+  // followed by one line per client that has any traffic
+  // Returns amount of reported lines
+  int Report(char *strBuffer, size_t ctBufferSize)
+  {
+    // Sort used types by their traffic
+    int aiTypes[k_ctPluginPacketStatsTypes];
+    int ctTypes = 0;
+
+    for (int iType = 0; iType < k_ctPluginPacketStatsTypes; iType++) {
+      const Type_t &type = m_aTypes[iType];
+      if (type.m_lType == -1 || (type.m_traffic.m_ctSent == 0 && type.m_traffic.m_ctReceived == 0)) continue;
+
+      const ULONG ulBytes = type.m_traffic.GetTotalBytes();
+      int iInsert = ctTypes++;
+
+      for (; iInsert > 0 && m_aTypes[aiTypes[iInsert - 1]].m_traffic.GetTotalBytes() < ulBytes; iInsert--) {
+        aiTypes[iInsert] = aiTypes[iInsert - 1];
+      }
+
+      aiTypes[iInsert] = iType;
+    }
+
+    int ctLines = 0;
+    size_t ctUsed = 0;
+    strBuffer[0] = '\0';
+
+    for (int iLine = 0; iLine < ctTypes + k_ctPluginPacketStatsClients; iLine++) {
+      const PluginPacketTraffic_t *pTraffic;
+      char strLine[256];
+
+      if (iLine < ctTypes) {
+        const Type_t &type = m_aTypes[aiTypes[iLine]];
+        pTraffic = &type.m_traffic;
+        sprintf(strLine, "type %lu: ", (unsigned long)type.m_lType);
+
+      } else {
+        const INDEX iClient = iLine - ctTypes;
+        pTraffic = &m_aClients[iClient];
+
+        if (pTraffic->m_ctSent == 0 && pTraffic->m_ctReceived == 0) continue;
+        sprintf(strLine, "client %d: ", (int)iClient);
+      }
+
+      const size_t ctPrefix = strlen(strLine);
+      sprintf(strLine + ctPrefix, "sent %lu (%lu B), received %lu (%lu B), read %lu us, process %lu us, routed %lu us\n",
+        (unsigned long)pTraffic->m_ctSent, (unsigned long)pTraffic->m_ctBytesSent,
+        (unsigned long)pTraffic->m_ctReceived, (unsigned long)pTraffic->m_ctBytesReceived,
+        (unsigned long)pTraffic->m_ctReadTime, (unsigned long)pTraffic->m_ctProcessTime,
+        (unsigned long)pTraffic->m_ctRoutedTime);
+
+      if (ctUsed + 1 >= ctBufferSize) break;
+
+      CopyZeroTerminatedString(strBuffer + ctUsed, strLine, ctBufferSize - ctUsed);
+      ctUsed += strlen(strBuffer + ctUsed);
+      ctLines++;
+    }
+
+    return ctLines;
+  };
+
+  // Output a report every specific amount of ticks of the PluginTimers() wheel
+  void StartDump(ULONG ulInterval, FPluginPacketStatsOutput pOutput, void *pUserData = NULL, bool bResetAfterDump = true)
+  {
+    m_pOutput = pOutput;
+    m_pOutputData = pUserData;
+    m_bResetAfterDump = bResetAfterDump;
+    PluginTimers().Start(m_tmrDump, ulInterval, ulInterval);
+  };
+
+  // Stop periodic dumps
+  inline void StopDump(void) {
+    m_tmrDump.Unlink();
+  };
+
+private:
+  static void PATCH_CALLTYPE DumpTimer(PluginTimer_t *pTimer, void *pUserData)
+  {
+    PluginPacketStats_t &stats = *(PluginPacketStats_t *)pUserData;
+    if (stats.m_pOutput == NULL) return;
+
+    static char _strReport[k_ctPluginPacketStatsDumpSize];
+
+    if (stats.Report(_strReport, sizeof(_strReport)) != 0) {
+      stats.m_pOutput(_strReport, stats.m_pOutputData);
+    }
+
+    if (stats.m_bResetAfterDump) stats.Reset();
+  };
+
+  // Statistics own their dump timer and cannot be copied
+  PluginPacketStats_t(const PluginPacketStats_t &);
+  PluginPacketStats_t &operator=(const PluginPacketStats_t &);
+};
+
+// Traffic counters of the current module
+inline PluginPacketStats_t &PluginPacketStats(void) {
+  static PluginPacketStats_t _stats;
+  return _stats;
+};
+
+// Wrapper that sends another packet as is and counts its size
+// Network messages may be written more than once per send, so only the last written size is counted
+template<class MessageType = CNetworkMessage>
+class PluginPacketMeter_t : public IClassicsExtPacket
+{
+public:
+  IClassicsExtPacket *m_pPacket;
+  INDEX m_iClient; // Client that's being counted as the recipient or -1 for none, e.g. for broadcasts
+  SLONG m_slBytes; // Size of the last written packet or -1 if it hasn't been written
+
+public:
+  PluginPacketMeter_t(IClassicsExtPacket *pPacket, INDEX iClient = -1) : m_pPacket(pPacket), m_iClient(iClient), m_slBytes(-1) {};
+
+  virtual EPacketType GetType(void) const { return m_pPacket->GetType(); };
+  virtual const char *GetName(void) const { return m_pPacket->GetName(); };
+
+  virtual void SendToClients(void)
+  {
+    m_slBytes = -1;
+    IClassicsExtPacket::SendToClients();
+    Count();
+  };
+
+  virtual void SendToServer(void)
+  {
+    m_slBytes = -1;
+    IClassicsExtPacket::SendToServer();
+    Count();
+  };
+
+  virtual bool Write(class CNetworkMessage &nmMessage)
+  {
+    MessageType &nm = (MessageType &)nmMessage;
+    const SLONG slStart = nm.nm_slSize;
+
+    if (!m_pPacket->Write(nmMessage)) {
+      m_slBytes = -1;
+      return false;
+    }
+
+    m_slBytes = nm.nm_slSize - slStart;
+    return true;
+  };
+
+private:
+  void Count(void)
+  {
+    if (m_slBytes >= 0) PluginPacketStats().CountSent(GetType(), m_iClient, m_slBytes);
+  };
+};
+
+// Pass a received packet into a router and count it together with all of its remaining data
+// Handlers both read and process packets, so time spent in the router is counted as routed time
+// Returns result of the router
+template<class MessageType> inline
+BOOL PluginPacketStats_Dispatch(MessageType &nm, const ULONG ulType, INDEX iClient, const ExtPacketRouter_t &router)
+{
+  const SLONG slBytes = nm.nm_slSize - SLONG(nm.nm_pubPointer - nm.nm_pubMessage);
+  const __int64 llStart = PluginEventStats_GetMicroseconds();
+
+  const BOOL bHandled = router.Dispatch(nm, ulType);
+
+  PluginPacketStats().CountReceived(ulType, iClient, slBytes, -1, PluginEventStats_GetMicroseconds() - llStart);
+  return bHandled;
+};
+
+// Read and process a received packet while counting both steps separately
+template<class MessageType> inline
+void PluginPacketStats_ReadAndProcess(MessageType &nm, IClassicsExtPacket &pck, INDEX iClient)
+{
+  const SLONG slBytes = nm.nm_slSize - SLONG(nm.nm_pubPointer - nm.nm_pubMessage);
+  const __int64 llStart = PluginEventStats_GetMicroseconds();
+
+  pck.Read(nm);
+  const __int64 llRead = PluginEventStats_GetMicroseconds();
+
+  pck.Process();
+  const __int64 llProcessed = PluginEventStats_GetMicroseconds();
+
+  PluginPacketStats().CountReceived(pck.GetType(), iClient, slBytes, llRead - llStart, llProcessed - llRead);
+};
+
+// Chat command for viewing traffic counters of the current module
+// Arguments: "reset" to reset counters, nothing to view them
+inline BOOL PATCH_CALLTYPE PluginPacketStats_ChatCommand(ChatCommandResultStr &strResult, INDEX iClient, const char *strArguments)
+{
+  if (strcmp(strArguments, "reset") == 0) {
+    PluginPacketStats().Reset();
+    CopyZeroTerminatedString(strResult, "Packet traffic reset", k_cchMaxChatCommandResultStr);
+
+  } else if (PluginPacketStats().Report(strResult, k_cchMaxChatCommandResultStr) == 0) {
+    CopyZeroTerminatedString(strResult, "No packet traffic", k_cchMaxChatCommandResultStr);
+  }
+
+  return TRUE;
+};
+
+// Register a chat command for viewing traffic counters of the current module
+// The command is only accessible to server operators
+inline void PluginPacketStats_RegisterChatCommand(const char *strCommand)
+{
+  ClassicsChat_RegisterCommandPure(strCommand, &PluginPacketStats_ChatCommand);
+  ClassicsChat_SetCommandAccess(strCommand, k_EChatCommandAccessLevel_Operator, TRUE);
+  ClassicsChat_SetCommandInfo(strCommand, "[reset]", "View traffic of extension packets");
+};
+
+#endif // CLASSICSPATCH_PLUGINPACKETSTATS_H
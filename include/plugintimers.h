@@ -0,0 +1,261 @@
+// Copyright (c) Dreamy Cecil; see copyright notice in LICENSE file
+
+#ifndef CLASSICSPATCH_PLUGINTIMERS_H
+#define CLASSICSPATCH_PLUGINTIMERS_H
+#ifdef _WIN32
+  #pragma once
+#endif
+
+#include "classicspatch_common.h"
+
+//================================================================================================//
+// Plugin timers
+//
+// One-shot and repeating timers that execute functions after a specific amount of game ticks,
+// instead of having to keep track of countdowns and check each one of them every tick.
+//
+// Timers are stored in a hierarchical timer wheel, so that advancing it by one tick only processes
+// timers that expire during that tick, no matter how many timers are pending. Timers that are due
+// in the distant future are moved closer by groups once every 256, 65536 and 16777216 ticks.
+//
+// Timers are owned by the caller and don't allocate any memory. A timer is stopped automatically
+// when it's destroyed.
+//
+// Example usage:
+//    static PluginTimer_t _tmrAnnounce;
+//
+//    void PATCH_CALLTYPE ITimerEvents_OnTick(void) {
+//      PluginTimers().Tick();
+//    };
+//
+//    CLASSICSPATCH_PLUGIN_STARTUP(HIniConfig props, PluginEvents_t &events) {
+//      // Call Announce() every minute starting from now
+//      _tmrAnnounce.m_pCallback = &Announce;
+//      PluginTimers().Start(_tmrAnnounce, 1, 60 * 20);
+//
+//      events.m_timer->OnTick = &ITimerEvents_OnTick;
+//    };
+//================================================================================================//
+
+struct PluginTimer_t;
+class PluginTimerWheel_t;
+
+// Function that's executed once the timer expires
+typedef void (PATCH_CALLTYPE *FPluginTimer)(PluginTimer_t *pTimer, void *pUserData);
+
+// One scheduled function
+struct PluginTimer_t
+{
+  FPluginTimer m_pCallback;
+  void *m_pUserData;
+
+  ULONG m_ulExpire; // Tick at which the timer expires
+  ULONG m_ulInterval; // Amount of ticks between repetitions or 0 for one-shot timers
+
+  // Wheel slot or a list of expired timers, if the timer is active
+  PluginTimer_t *m_pPrev;
+  PluginTimer_t *m_pNext;
+  PluginTimerWheel_t *m_pWheel;
+
+  PluginTimer_t(FPluginTimer pCallback = NULL, void *pUserData = NULL) :
+    m_pCallback(pCallback), m_pUserData(pUserData), m_ulExpire(0), m_ulInterval(0),
+    m_pPrev(NULL), m_pNext(NULL), m_pWheel(NULL) {};
+
+  ~PluginTimer_t() {
+    Unlink();
+  };
+
+  // Check whether the timer is waiting to expire
+  inline bool IsActive(void) const {
+    return (m_pWheel != NULL);
+  };
+
+  // Stop the timer without executing it
+  inline void Unlink(void)
+  {
+    if (m_pWheel == NULL) return;
+
+    m_pPrev->m_pNext = m_pNext;
+    m_pNext->m_pPrev = m_pPrev;
+    m_pPrev = m_pNext = NULL;
+    m_pWheel = NULL;
+  };
+
+  // Make timer an empty list of timers
+  inline void MakeList(void) {
+    m_pPrev = m_pNext = this;
+  };
+
+  // Add timer to the end of a list of timers
+  inline void LinkBefore(PluginTimer_t &list, PluginTimerWheel_t *pWheel)
+  {
+    m_pPrev = list.m_pPrev;
+    m_pNext = &list;
+    list.m_pPrev->m_pNext = this;
+    list.m_pPrev = this;
+    m_pWheel = pWheel;
+  };
+
+private:
+  // Timers are linked by their address and cannot be copied
+  PluginTimer_t(const PluginTimer_t &);
+  PluginTimer_t &operator=(const PluginTimer_t &);
+};
+
+// Hierarchical timer wheel with four levels of 256 slots
+class PluginTimerWheel_t
+{
+public:
+  enum {
+    k_ctLevels = 4,
+    k_iSlotBits = 8,
+    k_ctSlots = (1 << k_iSlotBits),
+    k_ulSlotMask = k_ctSlots - 1,
+  };
+
+  // Lists of timers in each slot of each level
+  PluginTimer_t m_aSlots[k_ctLevels][k_ctSlots];
+
+  // Amount of processed ticks
+  ULONG m_ulTick;
+
+public:
+  PluginTimerWheel_t() : m_ulTick(0)
+  {
+    for (int iLevel = 0; iLevel < k_ctLevels; iLevel++) {
+      for (int iSlot = 0; iSlot < k_ctSlots; iSlot++) {
+        m_aSlots[iLevel][iSlot].MakeList();
+      }
+    }
+  };
+
+  ~PluginTimerWheel_t() {
+    StopAll();
+  };
+
+  // Get amount of processed ticks
+  inline ULONG GetTick(void) const {
+    return m_ulTick;
+  };
+
+  // Start a timer that expires after a specific amount of ticks (at least 1)
+  // If the interval isn't 0, the timer restarts with that many ticks after each expiration
+  void Start(PluginTimer_t &timer, ULONG ulDelay, ULONG ulInterval = 0)
+  {
+    timer.Unlink();
+    timer.m_ulExpire = m_ulTick + (ulDelay != 0 ? ulDelay : 1);
+    timer.m_ulInterval = ulInterval;
+    Insert(timer);
+  };
+
+  // Stop a timer without executing it
+  inline void Stop(PluginTimer_t &timer) {
+    timer.Unlink();
+  };
+
+  // Stop all timers
+  void StopAll(void)
+  {
+    for (int iLevel = 0; iLevel < k_ctLevels; iLevel++) {
+      for (int iSlot = 0; iSlot < k_ctSlots; iSlot++) {
+        PluginTimer_t &list = m_aSlots[iLevel][iSlot];
+
+        while (list.m_pNext != &list) {
+          list.m_pNext->Unlink();
+        }
+      }
+    }
+  };
+
+  // Advance by one tick and execute timers that expire during it
+  // Returns amount of executed timers
+  int Tick(void)
+  {
+    m_ulTick++;
+
+    // Move timers from higher levels closer whenever lower levels wrap around
+    const ULONG iSlot = (m_ulTick & k_ulSlotMask);
+
+    for (int iLevel = 1; iLevel < k_ctLevels; iLevel++) {
+      if ((m_ulTick >> ((iLevel - 1) * k_iSlotBits)) & k_ulSlotMask) break;
+
+      Cascade(m_aSlots[iLevel][(m_ulTick >> (iLevel * k_iSlotBits)) & k_ulSlotMask]);
+    }
+
+    // Detach expired timers, so that they can be started or stopped from callbacks
+    PluginTimer_t expired;
+    expired.MakeList();
+    MoveList(m_aSlots[0][iSlot], expired);
+
+    int ctExecuted = 0;
+
+    while (expired.m_pNext != &expired) {
+      PluginTimer_t &timer = *expired.m_pNext;
+      timer.Unlink();
+
+      // Restart before executing to let callbacks stop repeating timers
+      if (timer.m_ulInterval != 0) {
+        timer.m_ulExpire = m_ulTick + timer.m_ulInterval;
+        Insert(timer);
+      }
+
+      timer.m_pCallback(&timer, timer.m_pUserData);
+      ctExecuted++;
+    }
+
+    return ctExecuted;
+  };
+
+private:
+  // Put an unlinked timer into a slot that matches its expiration tick
+  void Insert(PluginTimer_t &timer)
+  {
+    const ULONG ulDelta = timer.m_ulExpire - m_ulTick;
+    int iLevel = 0;
+
+    while (iLevel < k_ctLevels - 1 && (ulDelta >> ((iLevel + 1) * k_iSlotBits)) != 0) {
+      iLevel++;
+    }
+
+    const ULONG iSlot = (timer.m_ulExpire >> (iLevel * k_iSlotBits)) & k_ulSlotMask;
+    timer.LinkBefore(m_aSlots[iLevel][iSlot], this);
+  };
+
+  // Reinsert all timers from a higher level slot into lower levels
+  void Cascade(PluginTimer_t &slot)
+  {
+    PluginTimer_t list;
+    list.MakeList();
+    MoveList(slot, list);
+
+    while (list.m_pNext != &list) {
+      PluginTimer_t &timer = *list.m_pNext;
+      timer.Unlink();
+      Insert(timer);
+    }
+  };
+
+  // Move all timers from one list into another empty list
+  static void MoveList(PluginTimer_t &from, PluginTimer_t &to)
+  {
+    if (from.m_pNext == &from) return;
+
+    to.m_pNext = from.m_pNext;
+    to.m_pPrev = from.m_pPrev;
+    to.m_pNext->m_pPrev = &to;
+    to.m_pPrev->m_pNext = &to;
+    from.MakeList();
+  };
+
+  // Wheels hold addresses of their timers and cannot be copied
+  PluginTimerWheel_t(const PluginTimerWheel_t &);
+  PluginTimerWheel_t &operator=(const PluginTimerWheel_t &);
+};
+
+// Timer wheel of the current module
+inline PluginTimerWheel_t &PluginTimers(void) {
+  static PluginTimerWheel_t _wheel;
+  return _wheel;
+};
+
+#endif // CLASSICSPATCH_PLUGINTIMERS_H
@@ -23,6 +23,19 @@ enum EPluginFlags {
   k_EPluginFlagAll = (1 << 5) - 1, // Suitable for everything
 };
 
+// Get utility flags of plugins that are suitable for a specific application
+// Plugins are suitable if they have at least one of these flags set
+inline ULONG PluginFlags_ForAppType(EClassicsPatchAppType eApp)
+{
+  switch (eApp) {
+    case k_EClassicsPatchAppType_Game:    return k_EPluginFlagEngine | k_EPluginFlagGame;
+    case k_EClassicsPatchAppType_Server:  return k_EPluginFlagEngine | k_EPluginFlagServer;
+    case k_EClassicsPatchAppType_Editor:  return k_EPluginFlagEngine | k_EPluginFlagEditor;
+    case k_EClassicsPatchAppType_Modeler: return k_EPluginFlagEngine | k_EPluginFlagTools;
+    default: return k_EPluginFlagEngine;
+  }
+};
+
 const int k_cchMaxPluginInfoString = 256;
 
 // Information about the plugin set by the plugin (but never instantiated by it!)
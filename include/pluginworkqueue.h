@@ -0,0 +1,180 @@
+// Copyright (c) Dreamy Cecil; see copyright notice in LICENSE file
+
+#ifndef CLASSICSPATCH_PLUGINWORKQUEUE_H
+#define CLASSICSPATCH_PLUGINWORKQUEUE_H
+#ifdef _WIN32
+  #pragma once
+#endif
+
+#include "classicspatch_common.h"
+#include "plugineventstats.h"
+
+//================================================================================================//
+// Plugin work queue
+//
+// Queue of heavy tasks that are split into small resumable steps (e.g. processing the next 100
+// entities of the world), which are executed over multiple ticks instead of all at once. Each time
+// the queue is run, it executes steps of queued tasks in turns until it runs out of its time budget.
+//
+// Steps run on the simulation thread, so they can interact with the engine. The queue should be run
+// at the very end of IProcessingEvents::OnStep after everything else.
+//
+// Work items are owned by the caller and don't allocate any memory. An item is removed from the
+// queue automatically when it's destroyed.
+//
+// Example usage:
+//    // Scan 100 entities per step and return TRUE after the last one
+//    BOOL PATCH_CALLTYPE ScanEntities(void *pUserData) {
+//      ScanState &state = *(ScanState *)pUserData;
+//      ...
+//      return (state.iNext >= ctEntities);
+//    };
+//
+//    static PluginWorkItem_t _wiScan(&ScanEntities, &_state);
+//
+//    void PATCH_CALLTYPE IProcessingEvents_OnStep(void) {
+//      ...
+//      if (bStartScan) PluginWorkQueue().Add(_wiScan);
+//
+//      PluginWorkQueue().Run();
+//    };
+//================================================================================================//
+
+// Function that executes one step of a task
+// Returns TRUE when the entire task is finished or FALSE if it needs more steps
+typedef BOOL (PATCH_CALLTYPE *FPluginWorkStep)(void *pUserData);
+
+// One queued task
+struct PluginWorkItem_t
+{
+  FPluginWorkStep m_pStep;
+  void *m_pUserData;
+
+  // Neighbor items in a queue, if queued
+  PluginWorkItem_t *m_pPrev;
+  PluginWorkItem_t *m_pNext;
+  bool m_bQueued;
+
+  PluginWorkItem_t(FPluginWorkStep pStep = NULL, void *pUserData = NULL) :
+    m_pStep(pStep), m_pUserData(pUserData), m_pPrev(NULL), m_pNext(NULL), m_bQueued(false) {};
+
+  ~PluginWorkItem_t() {
+    Unlink();
+  };
+
+  // Check whether the task is still in a queue
+  inline bool IsQueued(void) const {
+    return m_bQueued;
+  };
+
+  // Remove item from its queue
+  inline void Unlink(void)
+  {
+    if (!m_bQueued) return;
+
+    m_pPrev->m_pNext = m_pNext;
+    m_pNext->m_pPrev = m_pPrev;
+    m_pPrev = m_pNext = NULL;
+    m_bQueued = false;
+  };
+
+  // Add item to the end of a queue
+  inline void LinkBefore(PluginWorkItem_t &list)
+  {
+    m_pPrev = list.m_pPrev;
+    m_pNext = &list;
+    list.m_pPrev->m_pNext = this;
+    list.m_pPrev = this;
+    m_bQueued = true;
+  };
+
+private:
+  // Items are linked by their address and cannot be copied
+  PluginWorkItem_t(const PluginWorkItem_t &);
+  PluginWorkItem_t &operator=(const PluginWorkItem_t &);
+};
+
+// Queue of tasks that are executed within a time budget
+class PluginWorkQueue_t
+{
+public:
+  // Queued items in the order of their next steps
+  PluginWorkItem_t m_list;
+
+  // Time budget per run in microseconds
+  __int64 m_llBudget;
+
+public:
+  PluginWorkQueue_t(__int64 llBudget = 1000) : m_llBudget(llBudget)
+  {
+    m_list.m_pPrev = m_list.m_pNext = &m_list;
+  };
+
+  ~PluginWorkQueue_t() {
+    Clear();
+  };
+
+  // Check whether there are any queued tasks
+  inline bool IsEmpty(void) const {
+    return (m_list.m_pNext == &m_list);
+  };
+
+  // Add a task to the end of the queue, if it isn't queued yet
+  void Add(PluginWorkItem_t &item)
+  {
+    if (item.IsQueued()) return;
+    item.LinkBefore(m_list);
+  };
+
+  // Remove a task from the queue without finishing it
+  inline void Remove(PluginWorkItem_t &item) {
+    item.Unlink();
+  };
+
+  // Remove all tasks
+  void Clear(void)
+  {
+    while (!IsEmpty()) {
+      m_list.m_pNext->Unlink();
+    }
+  };
+
+  // Execute steps of queued tasks in turns until the time budget is used up
+  // At least one step is executed if there are any tasks, so that they always progress
+  // Returns amount of executed steps
+  int Run(void)
+  {
+    if (IsEmpty()) return 0;
+
+    const __int64 llStart = PluginEventStats_GetMicroseconds();
+    int ctSteps = 0;
+
+    do {
+      // Move the task to the end before its step, so that it may be removed from the step function
+      PluginWorkItem_t &item = *m_list.m_pNext;
+      item.Unlink();
+      item.LinkBefore(m_list);
+
+      if (item.m_pStep(item.m_pUserData)) {
+        item.Unlink();
+      }
+
+      ctSteps++;
+    } while (!IsEmpty() && PluginEventStats_GetMicroseconds() - llStart < m_llBudget);
+
+    return ctSteps;
+  };
+
+private:
+  // Queues hold addresses of their items and cannot be copied
+  PluginWorkQueue_t(const PluginWorkQueue_t &);
+  PluginWorkQueue_t &operator=(const PluginWorkQueue_t &);
+};
+
+// Work queue of the current module
+inline PluginWorkQueue_t &PluginWorkQueue(void) {
+  static PluginWorkQueue_t _queue;
+  return _queue;
+};
+
+#endif // CLASSICSPATCH_PLUGINWORKQUEUE_H